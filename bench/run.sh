@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# Build bench/vec2_bench.cpp once per Vec2 header (original, every
+# refactoring step in diffs/ and new/) and print, for each kernel, the
+# time per op, the retired instructions per op and the number of
+# instructions the compiler generated for the kernel. Steps that do not
+# compile on their own are patched by bench/shims/N.sed first.
+#
+# Usage: bench/run.sh [extra vec2_bench arguments]
+# CXX and CXXFLAGS are honoured (default: g++ -O2).
+#
+
+set -u
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${BENCH_OUT:-$ROOT/_bench}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+
+mkdir -p "$OUT"
+
+# original/ headers include each other as "lol/...", as they do in the
+# engine; point a lol/ include root at original/
+mkdir -p "$OUT/include"
+ln -sfn "$ROOT/original" "$OUT/include/lol"
+
+bench_one()
+{
+    label=$1
+    header=$2
+    exe="$OUT/vec2_bench_$label"
+
+    echo "== $label ($header)"
+    if ! $CXX -std=c++17 $CXXFLAGS -I"$OUT/include" -DLOL_VEC2_HEADER="\"$header\"" \
+            "$ROOT/bench/vec2_bench.cpp" -o "$exe" 2> "$exe.log"; then
+        echo "   skipped: does not compile, see $exe.log"
+        echo
+        return
+    fi
+
+    # Static instruction count of every kernel symbol
+    objdump -d --no-show-raw-insn "$exe" | awk '
+        /^[0-9a-f]+ <(vec|scalar|cmp|len|geo)_[a-z]+_[fi]>:$/ {
+            name = $2; gsub(/[<>:]/, "", name); next
+        }
+        /^$/ { name = "" }
+        name != "" && /^ +[0-9a-f]+:/ { count[name]++ }
+        END { for (n in count) print n, count[n] }' > "$exe.static"
+
+    "$exe" "$@" | awk -v static="$exe.static" '
+        BEGIN { while ((getline line < static) > 0) { split(line, f, " "); n[f[1]] = f[2] } }
+        NR == 1 { printf "%s %10s\n", $0, "generated"; next }
+        { printf "%s %10s\n", $0, ($1 in n) ? n[$1] : "inlined" }'
+    echo
+}
+
+bench_one original "$ROOT/original/matrix.h" "$@"
+for dir in "$ROOT"/diffs/*/; do
+    step=$(basename "$dir")
+    label=$(echo "$step" | cut -d- -f1)
+    dir=${dir%/}
+    header="$dir/vec2.h"
+    [ -f "$header" ] || header="$dir/matrix.h"
+    # Snapshots caught mid-refactoring do not compile as they are; build
+    # a copy with the fixes from bench/shims/N.sed applied
+    shim="$ROOT/bench/shims/$label.sed"
+    if [ -f "$shim" ]; then
+        copy="$OUT/step$label"
+        mkdir -p "$copy"
+        cp "$dir"/*.h "$copy/"
+        sed -f "$shim" "$header" > "$copy/$(basename "$header")"
+        header="$copy/$(basename "$header")"
+    fi
+    bench_one "step$label" "$header" "$@"
+done
+bench_one new "$ROOT/new/vec2.h" "$@"
@@ -0,0 +1,320 @@
+//
+// Vec2 operator benchmark
+// -----------------------
+// Times every Vec2 operator family over arrays of vec2/vec2i and reports
+// ns/op and, where the kernel allows it, retired instructions per op. The
+// geometric functions (dot, cross, lerp, min, max, abs, clamp) are timed
+// too when the header has them.
+// The header under test is chosen at compile time so the same kernels can
+// be run against original/matrix.h, each diffs/N snapshot and new/vec2.h:
+//
+//   g++ -O2 -std=c++17 -DLOL_VEC2_HEADER='"../new/vec2.h"' vec2_bench.cpp
+//
+// Every kernel is an extern "C" noinline function so that bench/run.sh can
+// also count the instructions the compiler generated for it.
+//
+
+#if !defined LOL_VEC2_HEADER
+#   error "define LOL_VEC2_HEADER to the Vec2 header to benchmark"
+#endif
+
+#include LOL_VEC2_HEADER
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined __linux__
+#   include <linux/perf_event.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+using vec2f = lol::Vec2<float>;
+using vec2i = lol::Vec2<int>;
+
+#define NOINLINE extern "C" __attribute__((noinline))
+
+// Vector operators: out = a op b, then a op= b
+#define VECTOR_KERNELS(T, name, op)                                                  \
+    NOINLINE void vec_##name##_##T(const vec2##T* a, const vec2##T* b, vec2##T* out, int n) \
+    {                                                                                \
+        for(int i = 0; i < n; ++i) out[i] = a[i] op b[i];                            \
+    }                                                                                \
+    NOINLINE void vec_##name##eq_##T(vec2##T* a, const vec2##T* b, vec2##T*, int n)  \
+    {                                                                                \
+        for(int i = 0; i < n; ++i) a[i] op##= b[i];                                  \
+    }
+
+// Scalar operators: out = a op s
+#define SCALAR_KERNELS(T, S, name, op)                                               \
+    NOINLINE void scalar_##name##_##T(const vec2##T* a, const vec2##T*, vec2##T* out, int n) \
+    {                                                                                \
+        for(int i = 0; i < n; ++i) out[i] = a[i] op S(3);                            \
+    }
+
+// Comparison operators: number of a op b that hold
+#define COMPARE_KERNELS(T, name, op)                                                 \
+    NOINLINE int cmp_##name##_##T(const vec2##T* a, const vec2##T* b, vec2##T*, int n) \
+    {                                                                                \
+        int ret = 0;                                                                 \
+        for(int i = 0; i < n; ++i) ret += (a[i] op b[i]) ? 1 : 0;                    \
+        return ret;                                                                  \
+    }
+
+#define ALL_KERNELS(T, S)                                                            \
+    VECTOR_KERNELS(T, add, +) VECTOR_KERNELS(T, sub, -)                              \
+    VECTOR_KERNELS(T, mul, *) VECTOR_KERNELS(T, div, /)                              \
+    SCALAR_KERNELS(T, S, add, +) SCALAR_KERNELS(T, S, sub, -)                        \
+    SCALAR_KERNELS(T, S, mul, *) SCALAR_KERNELS(T, S, div, /)                        \
+    COMPARE_KERNELS(T, eq, ==) COMPARE_KERNELS(T, ne, !=)                            \
+    COMPARE_KERNELS(T, lt, <)  COMPARE_KERNELS(T, le, <=)                            \
+    COMPARE_KERNELS(T, gt, >)  COMPARE_KERNELS(T, ge, >=)                            \
+    NOINLINE S len_sqlen_##T(const vec2##T* a, const vec2##T*, vec2##T*, int n)      \
+    {                                                                                \
+        S ret = 0;                                                                   \
+        for(int i = 0; i < n; ++i) ret += a[i].sqlen();                              \
+        return ret;                                                                  \
+    }                                                                                \
+    NOINLINE float len_len_##T(const vec2##T* a, const vec2##T*, vec2##T*, int n)    \
+    {                                                                                \
+        float ret = 0;                                                               \
+        for(int i = 0; i < n; ++i) ret += a[i].len();                                \
+        return ret;                                                                  \
+    }
+
+ALL_KERNELS(f, float)
+ALL_KERNELS(i, int)
+
+// Geometric operations are free functions found by ADL, and only the
+// newer headers have them; the kernels do nothing for the others and are
+// not run
+template <typename TVec, typename = void>
+struct HasGeometry : std::false_type { };
+template <typename TVec>
+struct HasGeometry<TVec, std::void_t<decltype(clamp(std::declval<TVec>(), std::declval<TVec>(), std::declval<TVec>()))>>
+    : std::true_type { };
+
+// Vector results are written to out, scalar ones summed
+template <typename TVec, typename TFunc>
+double geoLoop(const TVec* a, const TVec* b, TVec* out, int n, TFunc func)
+{
+    double ret = 0;
+    if constexpr (HasGeometry<TVec>::value)
+    {
+        for(int i = 0; i < n; ++i)
+        {
+            const auto r = func(a[i], b[i]);
+            if constexpr (std::is_same_v<std::decay_t<decltype(r)>, TVec>)
+                out[i] = r;
+            else
+                ret += r;
+        }
+    }
+    else
+    {
+        (void)a; (void)b; (void)out; (void)n; (void)func;
+    }
+    return ret;
+}
+
+#define GEO_KERNEL(T, name, expr)                                                    \
+    NOINLINE double geo_##name##_##T(const vec2##T* a, const vec2##T* b, vec2##T* out, int n) \
+    {                                                                                \
+        return geoLoop(a, b, out, n, [](const auto& x, const auto& y) { (void)y; return expr; }); \
+    }
+
+#define GEO_KERNELS(T, S)                                                            \
+    GEO_KERNEL(T, dot, dot(x, y)) GEO_KERNEL(T, cross, cross(x, y))                  \
+    GEO_KERNEL(T, min, min(x, y)) GEO_KERNEL(T, max, max(x, y))                      \
+    GEO_KERNEL(T, abs, abs(x - y)) GEO_KERNEL(T, clamp, clamp(x, S(10), S(60)))
+
+GEO_KERNELS(f, float)
+GEO_KERNELS(i, int)
+GEO_KERNEL(f, lerp, lerp(x, y, 0.25f))
+
+namespace
+{
+    // Retired user-space instructions, when the kernel lets us count them
+    class InstructionCounter
+    {
+    public:
+        InstructionCounter()
+        {
+#if defined __linux__
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        ~InstructionCounter()
+        {
+#if defined __linux__
+            if(m_fd >= 0) close(m_fd);
+#endif
+        }
+
+        bool valid() const { return m_fd >= 0; }
+
+        void start()
+        {
+#if defined __linux__
+            if(m_fd < 0) return;
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        }
+
+        std::uint64_t stop()
+        {
+            std::uint64_t ret = 0;
+#if defined __linux__
+            if(m_fd < 0) return 0;
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if(read(m_fd, &ret, sizeof(ret)) != sizeof(ret)) ret = 0;
+#endif
+            return ret;
+        }
+
+    private:
+        int m_fd = -1;
+    };
+
+    volatile double g_sink;
+
+    template <typename TVec>
+    struct Data
+    {
+        std::vector<TVec> a, b, out;
+    };
+
+    template <typename TVec, typename TElem>
+    Data<TVec> makeData(int n)
+    {
+        Data<TVec> ret;
+        std::srand(1234);
+        for(int i = 0; i < n; ++i)
+        {
+            // Never zero, so that division is well defined for both types
+            ret.a.push_back(TVec(TElem(std::rand() % 100 + 1), TElem(std::rand() % 100 + 1)));
+            ret.b.push_back(TVec(TElem(std::rand() % 100 + 1), TElem(std::rand() % 100 + 1)));
+        }
+        ret.out = ret.a;
+        return ret;
+    }
+
+    struct Options
+    {
+        int count = 4096;       // elements per kernel call
+        double minTime = 0.05;  // seconds per kernel
+    };
+
+    template <typename TVec, typename TRet>
+    void run(const char* name, TRet (*kernel)(const TVec*, const TVec*, TVec*, int),
+             Data<TVec>& data, const Options& opts, InstructionCounter& counter)
+    {
+        using clock = std::chrono::steady_clock;
+        const int n = opts.count;
+
+        // Warm up and find a repeat count that lasts at least minTime
+        long repeat = 1;
+        double elapsed = 0.0;
+        for(;;)
+        {
+            auto start = clock::now();
+            for(long r = 0; r < repeat; ++r)
+                g_sink = g_sink + double(kernel(data.a.data(), data.b.data(), data.out.data(), n));
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            if(elapsed >= opts.minTime) break;
+            repeat *= 2;
+        }
+
+        counter.start();
+        kernel(data.a.data(), data.b.data(), data.out.data(), n);
+        std::uint64_t instructions = counter.stop();
+
+        std::printf("%-16s %10.3f", name, elapsed * 1e9 / (double(repeat) * n));
+        if(counter.valid())
+            std::printf(" %10.2f\n", double(instructions) / n);
+        else
+            std::printf(" %10s\n", "n/a");
+    }
+
+    // Kernels that write through out return void; wrap them so that every
+    // kernel has the same shape.
+    template <typename TVec, void (*TKernel)(const TVec*, const TVec*, TVec*, int)>
+    int voidKernel(const TVec* a, const TVec* b, TVec* out, int n)
+    {
+        TKernel(a, b, out, n);
+        return 0;
+    }
+
+    template <typename TVec, void (*TKernel)(TVec*, const TVec*, TVec*, int)>
+    int inplaceKernel(const TVec* a, const TVec* b, TVec* out, int n)
+    {
+        // Run on a fresh copy so that repeated calls do not overflow or go
+        // denormal; the copy is included in the timings of every snapshot
+        std::copy(a, a + n, out);
+        TKernel(out, b, nullptr, n);
+        return 0;
+    }
+}
+
+#define RUN_VECTOR(T, name)                                                          \
+    run<vec2##T>("vec_" #name "_" #T, voidKernel<vec2##T, vec_##name##_##T>, data##T, opts, counter); \
+    run<vec2##T>("vec_" #name "eq_" #T, inplaceKernel<vec2##T, vec_##name##eq_##T>, data##T, opts, counter);
+#define RUN_SCALAR(T, name)                                                          \
+    run<vec2##T>("scalar_" #name "_" #T, voidKernel<vec2##T, scalar_##name##_##T>, data##T, opts, counter);
+#define RUN_COMPARE(T, name)                                                         \
+    run<vec2##T>("cmp_" #name "_" #T, cmp_##name##_##T, data##T, opts, counter);
+#define RUN_ALL(T)                                                                   \
+    RUN_VECTOR(T, add) RUN_VECTOR(T, sub) RUN_VECTOR(T, mul) RUN_VECTOR(T, div)      \
+    RUN_SCALAR(T, add) RUN_SCALAR(T, sub) RUN_SCALAR(T, mul) RUN_SCALAR(T, div)      \
+    RUN_COMPARE(T, eq) RUN_COMPARE(T, ne) RUN_COMPARE(T, lt)                         \
+    RUN_COMPARE(T, le) RUN_COMPARE(T, gt) RUN_COMPARE(T, ge)                         \
+    run<vec2##T>("len_sqlen_" #T, len_sqlen_##T, data##T, opts, counter);            \
+    run<vec2##T>("len_len_" #T, len_len_##T, data##T, opts, counter);
+#define RUN_GEO(T, name)                                                             \
+    if(HasGeometry<vec2##T>::value)                                                  \
+        run<vec2##T>("geo_" #name "_" #T, geo_##name##_##T, data##T, opts, counter);
+#define RUN_ALL_GEO(T)                                                               \
+    RUN_GEO(T, dot) RUN_GEO(T, cross) RUN_GEO(T, min) RUN_GEO(T, max)                \
+    RUN_GEO(T, abs) RUN_GEO(T, clamp)
+
+int main(int argc, char** argv)
+{
+    Options opts;
+    for(int i = 1; i + 1 < argc; i += 2)
+    {
+        if(!std::strcmp(argv[i], "--count"))
+            opts.count = std::atoi(argv[i + 1]);
+        else if(!std::strcmp(argv[i], "--min-time"))
+            opts.minTime = std::atof(argv[i + 1]);
+    }
+
+    auto dataf = makeData<vec2f, float>(opts.count);
+    auto datai = makeData<vec2i, int>(opts.count);
+    InstructionCounter counter;
+
+    std::printf("%-16s %10s %10s\n", "kernel", "ns/op", "instr/op");
+    RUN_ALL(f)
+    RUN_ALL(i)
+    RUN_ALL_GEO(f)
+    RUN_GEO(f, lerp)
+    RUN_ALL_GEO(i)
+    return 0;
+}
@@ -0,0 +1,25 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Precision policies
+// ------------------
+// The precise_t and fast_t tags and the rsqrt(), sincos() and tan() that
+// take them are those of original/fastmath.h, where their error bounds
+// are documented. Keeping one definition lets a program use both the
+// engine and the new Vec types.
+//
+
+#if !defined __LOL_NEW_FASTMATH_H__
+#define __LOL_NEW_FASTMATH_H__
+
+#include "../original/fastmath.h"
+
+#endif // __LOL_NEW_FASTMATH_H__
@@ -0,0 +1,415 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The KdTree class
+// ----------------
+// A static k-d tree over an array of Vec2<float> or Vec3<float> points,
+// answering nearest neighbour, radius and box queries, one at a time or
+// in batches split across threads. Results identify points by their index
+// in the array given to build().
+//
+// The tree is implicit: the points are reordered so that every subtree
+// is a contiguous range whose middle element is the splitting point, and
+// ranges of at most leafSize points are scanned linearly. The only
+// per-node data is the split axis, so a query touches little more than
+// the points themselves.
+//
+//     lol::KdTree<3> tree(positions.data(), positions.size());
+//     std::uint32_t ids[4];
+//     float sqDists[4];
+//     const std::size_t found = tree.nearest(query, 4, ids, sqDists);
+//
+
+#if !defined __LOL_KDTREE_H__
+#define __LOL_KDTREE_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "vec.h"
+#include "vecbatch.h"
+
+namespace lol {
+
+template <std::size_t N> class KdTree {
+    static_assert(N == 2 || N == 3);
+
+public:
+    using TPoint = Vec<float, N>;
+
+    // Ranges of at most this many points are leaves
+    static constexpr std::size_t leafSize = 8;
+
+    // Id written by nearest_n() when there are fewer than k points
+    static constexpr std::uint32_t noPoint = ~std::uint32_t{0};
+
+    // Ctor
+    KdTree() = default;
+    KdTree(const TPoint* points, std::size_t count) { build(points, count); }
+
+    std::size_t size() const { return m_points.size(); }
+
+    // Builds the tree over count points; the top levels of large trees
+    // are built in parallel
+    void build(const TPoint* points, std::size_t count)
+    {
+        m_ids.resize(count);
+        for(std::size_t n = 0; n < count; ++n)
+        {
+            m_ids[n] = static_cast<std::uint32_t>(n);
+        }
+        rebuild(points);
+    }
+
+    // Builds again after the points moved, with the same count. Each range
+    // starts from its previous order, which is already close to
+    // partitioned when the points moved little. Only the first build
+    // allocates: it sizes the arrays, and a large one may start the
+    // details::ChunkPool workers that the later ones reuse.
+    void rebuild(const TPoint* points)
+    {
+        const std::size_t count = m_ids.size();
+        m_dims.resize(count);
+        details::ChunkPool& pool = details::ChunkPool::instance();
+        if(count < parallelBuild || pool.threads() < 2)
+        {
+            buildRange(points, 0, count);
+        }
+        else
+        {
+            // The top levels breadth first, a level at a time with one
+            // range per pool chunk, until there is a range per thread
+            m_ranges.assign(1, TRange{0, count});
+            while(!m_ranges.empty() && m_ranges.size() < pool.threads())
+            {
+                pool.run(m_ranges.size(), 1, [this, points](std::size_t begin, std::size_t end)
+                {
+                    for(std::size_t n = begin; n < end; ++n)
+                    {
+                        splitRange(points, m_ranges[n].first, m_ranges[n].second);
+                    }
+                });
+
+                m_nextRanges.clear();
+                for(const TRange& range : m_ranges)
+                {
+                    if(range.second - range.first > leafSize)
+                    {
+                        const std::size_t mid = range.first + (range.second - range.first) / 2;
+                        m_nextRanges.push_back(TRange{range.first, mid});
+                        m_nextRanges.push_back(TRange{mid + 1, range.second});
+                    }
+                }
+                std::swap(m_ranges, m_nextRanges);
+            }
+
+            pool.run(m_ranges.size(), 1, [this, points](std::size_t begin, std::size_t end)
+            {
+                for(std::size_t n = begin; n < end; ++n)
+                {
+                    buildRange(points, m_ranges[n].first, m_ranges[n].second);
+                }
+            });
+        }
+
+        m_points.resize(count);
+        for(std::size_t n = 0; n < count; ++n)
+        {
+            m_points[n] = points[m_ids[n]];
+        }
+    }
+
+    // The k nearest points, closest first. Returns how many were found,
+    // which is less than k only when the tree has fewer points.
+    std::size_t nearest(const TPoint& query, std::size_t k, std::uint32_t* ids, float* sqDists) const
+    {
+        std::size_t found = 0;
+        if(k > 0)
+        {
+            TPoint offsets(0.0f);
+            nearestRange(query, 0, size(), k, ids, sqDists, found, offsets, 0.0f);
+        }
+        for(std::size_t i = 0; i < found; ++i)
+        {
+            ids[i] = m_ids[ids[i]];
+        }
+        return found;
+    }
+
+    // nearest() for each query, writing k results per query. Missing
+    // results have the id noPoint and an infinite distance. Queries are
+    // split across threads like the vecbatch.h kernels.
+    void nearest_n(const TPoint* queries, std::size_t count, std::size_t k, std::uint32_t* ids, float* sqDists) const
+    {
+        details::forEachChunk(count, [this, queries, k, ids, sqDists](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                const std::size_t found = nearest(queries[n], k, ids + n * k, sqDists + n * k);
+                std::fill(ids + n * k + found, ids + (n + 1) * k, noPoint);
+                std::fill(sqDists + n * k + found, sqDists + (n + 1) * k, std::numeric_limits<float>::infinity());
+            }
+        }, parallelQueries);
+    }
+
+    // Calls func(id, sqDist) for each point within radius of center
+    template <typename TFunc>
+    void forEachInRadius(const TPoint& center, float radius, TFunc&& func) const
+    {
+        radiusRange(center, radius * radius, 0, size(), func);
+    }
+
+    // Calls func(id) for each point inside [min, max]
+    template <typename TFunc>
+    void forEachInBox(const TPoint& min, const TPoint& max, TFunc&& func) const
+    {
+        boxRange(min, max, 0, size(), func);
+    }
+
+    // forEachInRadius() around each center, calling func(n, id, sqDist)
+    // for query n. Queries are split across threads like nearest_n(): the
+    // calls for one query come from a single thread, but func must accept
+    // concurrent calls for different queries, e.g. by writing to per-query
+    // outputs.
+    template <typename TFunc>
+    void forEachInRadius_n(const TPoint* centers, std::size_t count, float radius, TFunc&& func) const
+    {
+        const float sqRadius = radius * radius;
+        details::forEachChunk(count, [this, centers, sqRadius, &func](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                auto found = [&func, n](std::uint32_t id, float sqDist) { func(n, id, sqDist); };
+                radiusRange(centers[n], sqRadius, 0, size(), found);
+            }
+        }, parallelQueries);
+    }
+
+    // forEachInBox() for each box [mins[n], maxs[n]], calling func(n, id),
+    // with the same threading as forEachInRadius_n()
+    template <typename TFunc>
+    void forEachInBox_n(const TPoint* mins, const TPoint* maxs, std::size_t count, TFunc&& func) const
+    {
+        details::forEachChunk(count, [this, mins, maxs, &func](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                auto found = [&func, n](std::uint32_t id) { func(n, id); };
+                boxRange(mins[n], maxs[n], 0, size(), found);
+            }
+        }, parallelQueries);
+    }
+
+private:
+    // Builds are split across threads above this many points, and batch
+    // queries above this many queries
+    static constexpr std::size_t parallelBuild = std::size_t{1} << 16;
+    static constexpr std::size_t parallelQueries = std::size_t{1} << 10;
+
+    using TRange = std::pair<std::size_t, std::size_t>;
+
+    void buildRange(const TPoint* points, std::size_t begin, std::size_t end)
+    {
+        if(splitRange(points, begin, end))
+        {
+            const std::size_t mid = begin + (end - begin) / 2;
+            buildRange(points, begin, mid);
+            buildRange(points, mid + 1, end);
+        }
+    }
+
+    // Splits along the axis of largest extent, at the median; false for
+    // leaves, which are not split
+    bool splitRange(const TPoint* points, std::size_t begin, std::size_t end)
+    {
+        if(end - begin <= leafSize)
+        {
+            return false;
+        }
+
+        TPoint lo = points[m_ids[begin]], hi = lo;
+        for(std::size_t n = begin + 1; n < end; ++n)
+        {
+            const TPoint& p = points[m_ids[n]];
+            for(int k = 0; k < static_cast<int>(N); ++k)
+            {
+                lo.begin()[k] = std::min(lo[k], p[k]);
+                hi.begin()[k] = std::max(hi[k], p[k]);
+            }
+        }
+        int dim = 0;
+        for(int k = 1; k < static_cast<int>(N); ++k)
+        {
+            if(hi[k] - lo[k] > hi[dim] - lo[dim])
+            {
+                dim = k;
+            }
+        }
+
+        const std::size_t mid = begin + (end - begin) / 2;
+        std::nth_element(m_ids.begin() + begin, m_ids.begin() + mid, m_ids.begin() + end,
+                         [=](std::uint32_t lhs, std::uint32_t rhs) { return points[lhs][dim] < points[rhs][dim]; });
+        m_dims[mid] = static_cast<std::uint8_t>(dim);
+        return true;
+    }
+
+    // Inserts slot n into the first found results, kept sorted by distance
+    void insert(std::size_t n, float sqDist, std::size_t k, std::uint32_t* ids, float* sqDists, std::size_t& found) const
+    {
+        if(found == k && sqDist >= sqDists[k - 1])
+        {
+            return;
+        }
+        std::size_t i = found < k ? found++ : k - 1;
+        for(; i > 0 && sqDists[i - 1] > sqDist; --i)
+        {
+            ids[i] = ids[i - 1];
+            sqDists[i] = sqDists[i - 1];
+        }
+        ids[i] = static_cast<std::uint32_t>(n);
+        sqDists[i] = sqDist;
+    }
+
+    // Visits the side of the split holding the query first, and the other
+    // side only if it can hold a closer point than the current k-th one.
+    // offsets holds the distance from the query to the current range's
+    // region along each axis, and sqBound the squared norm of offsets, a
+    // lower bound on the distance to any point of the range; this prunes
+    // far better than the distance to the split plane alone when the
+    // query is outside the point cloud.
+    void nearestRange(const TPoint& query, std::size_t begin, std::size_t end, std::size_t k,
+                      std::uint32_t* ids, float* sqDists, std::size_t& found, TPoint& offsets, float sqBound) const
+    {
+        if(end - begin <= leafSize)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                insert(n, (m_points[n] - query).sqlen(), k, ids, sqDists, found);
+            }
+            return;
+        }
+
+        const std::size_t mid = begin + (end - begin) / 2;
+        const int dim = m_dims[mid];
+        const float diff = query[dim] - m_points[mid][dim];
+        insert(mid, (m_points[mid] - query).sqlen(), k, ids, sqDists, found);
+
+        const std::size_t nearBegin = diff < 0.0f ? begin : mid + 1;
+        const std::size_t nearEnd = diff < 0.0f ? mid : end;
+        const std::size_t farBegin = diff < 0.0f ? mid + 1 : begin;
+        const std::size_t farEnd = diff < 0.0f ? end : mid;
+        nearestRange(query, nearBegin, nearEnd, k, ids, sqDists, found, offsets, sqBound);
+
+        const float offset = offsets[dim];
+        const float farBound = sqBound - offset * offset + diff * diff;
+        if(found < k || farBound < sqDists[k - 1])
+        {
+            offsets.begin()[dim] = diff;
+            nearestRange(query, farBegin, farEnd, k, ids, sqDists, found, offsets, farBound);
+            offsets.begin()[dim] = offset;
+        }
+    }
+
+    template <typename TFunc>
+    void radiusRange(const TPoint& center, float sqRadius, std::size_t begin, std::size_t end, TFunc& func) const
+    {
+        if(end - begin <= leafSize)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                const float sqDist = (m_points[n] - center).sqlen();
+                if(sqDist <= sqRadius)
+                {
+                    func(m_ids[n], sqDist);
+                }
+            }
+            return;
+        }
+
+        const std::size_t mid = begin + (end - begin) / 2;
+        const int dim = m_dims[mid];
+        const float diff = center[dim] - m_points[mid][dim];
+        const float sqDist = (m_points[mid] - center).sqlen();
+        if(sqDist <= sqRadius)
+        {
+            func(m_ids[mid], sqDist);
+        }
+        if(diff <= 0.0f || diff * diff <= sqRadius)
+        {
+            radiusRange(center, sqRadius, begin, mid, func);
+        }
+        if(diff >= 0.0f || diff * diff <= sqRadius)
+        {
+            radiusRange(center, sqRadius, mid + 1, end, func);
+        }
+    }
+
+    template <typename TFunc>
+    void boxRange(const TPoint& min, const TPoint& max, std::size_t begin, std::size_t end, TFunc& func) const
+    {
+        if(end - begin <= leafSize)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                if(inBox(m_points[n], min, max))
+                {
+                    func(m_ids[n]);
+                }
+            }
+            return;
+        }
+
+        const std::size_t mid = begin + (end - begin) / 2;
+        const int dim = m_dims[mid];
+        const float split = m_points[mid][dim];
+        if(inBox(m_points[mid], min, max))
+        {
+            func(m_ids[mid]);
+        }
+        if(min[dim] <= split)
+        {
+            boxRange(min, max, begin, mid, func);
+        }
+        if(max[dim] >= split)
+        {
+            boxRange(min, max, mid + 1, end, func);
+        }
+    }
+
+    static bool inBox(const TPoint& point, const TPoint& min, const TPoint& max)
+    {
+        for(int k = 0; k < static_cast<int>(N); ++k)
+        {
+            if(point[k] < min[k] || point[k] > max[k])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Per slot: the points in tree order, their original index, and the
+    // split axis of the range whose middle is that slot
+    std::vector<TPoint> m_points;
+    std::vector<std::uint32_t> m_ids;
+    std::vector<std::uint8_t> m_dims;
+
+    // Scratch for the parallel build, kept to avoid allocating again
+    std::vector<TRange> m_ranges, m_nextRanges;
+};
+
+} /* namespace lol */
+
+#endif // __LOL_KDTREE_H__
@@ -0,0 +1,251 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The Mat3 and Mat3x2 classes
+// ---------------------------
+// Mat3 is a 3x3 matrix of three Vec3 columns. Mat3x2 is a 2D affine
+// transform: the images of the X and Y axes and a translation, that is a
+// Mat3 whose last row is always (0, 0, 1) and is not stored. Transforming
+// a point takes four multiplies and four adds:
+//
+//     const lol::mat3x2 world = lol::mat3x2::translate(pos) * lol::mat3x2::rotate(angle);
+//     lol::transform_n(world, corners, corners);
+//
+// Products compose right to left, as with Mat4: (a * b) * p == a * (b * p).
+//
+
+#if !defined __LOL_MAT3_H__
+#define __LOL_MAT3_H__
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+#include "fastmath.h"
+#include "vec.h"
+#include "vec2.h"
+#include "vecbatch.h"
+
+namespace lol {
+
+template <typename TVec> class Mat3x2 {
+    static_assert(std::is_same_v<TVec, float>);
+
+public:
+    // Ctor
+    constexpr Mat3x2() : Mat3x2(Vec2<TVec>{1, 0}, Vec2<TVec>{0, 1}, Vec2<TVec>{0, 0}) { }
+    constexpr Mat3x2(const Vec2<TVec>& x, const Vec2<TVec>& y, const Vec2<TVec>& t) : m_cols{x, y, t} { }
+
+    static constexpr Mat3x2 translate(const Vec2<TVec>& t) { return Mat3x2{Vec2<TVec>{1, 0}, Vec2<TVec>{0, 1}, t}; }
+    static constexpr Mat3x2 scale(const Vec2<TVec>& s)     { return Mat3x2{Vec2<TVec>{s.X(), 0}, Vec2<TVec>{0, s.Y()}, Vec2<TVec>{}}; }
+    static constexpr Mat3x2 scale(TVec s)                  { return scale(Vec2<TVec>{s}); }
+
+    // Counter-clockwise, in radians
+    template <typename TPolicy = precise_t>
+    static Mat3x2 rotate(TVec angle, TPolicy policy = {})
+    {
+        TVec s, c;
+        sincos(angle, s, c, policy);
+        return Mat3x2{Vec2<TVec>{c, s}, Vec2<TVec>{-s, c}, Vec2<TVec>{}};
+    }
+
+    // Columns: 0 and 1 are the images of the axes, 2 the translation
+    constexpr const Vec2<TVec>& operator[](int n) const { return m_cols[n]; }
+    constexpr Vec2<TVec>& operator[](int n)             { return m_cols[n]; }
+
+    constexpr TVec det() const { return m_cols[0].X() * m_cols[1].Y() - m_cols[1].X() * m_cols[0].Y(); }
+
+    // Stores the inverse in ret and returns the determinant; ret is left
+    // untouched when the determinant is zero
+    constexpr TVec tryInvert(Mat3x2& ret) const
+    {
+        const TVec d = det();
+        if(d)
+        {
+            const TVec inv = TVec{1} / d;
+            const Vec2<TVec> x{m_cols[1].Y() * inv, -m_cols[0].Y() * inv};
+            const Vec2<TVec> y{-m_cols[1].X() * inv, m_cols[0].X() * inv};
+            const Vec2<TVec> t = x * -m_cols[2].X() - y * m_cols[2].Y();
+            ret = Mat3x2{x, y, t};
+        }
+        return d;
+    }
+
+    // The zero matrix when singular
+    constexpr Mat3x2 invert() const
+    {
+        Mat3x2 ret{Vec2<TVec>{}, Vec2<TVec>{}, Vec2<TVec>{}};
+        tryInvert(ret);
+        return ret;
+    }
+
+    constexpr Vec2<TVec> transformPoint(const Vec2<TVec>& p) const { return transformDir(p) + m_cols[2]; }
+    constexpr Vec2<TVec> transformDir(const Vec2<TVec>& d) const   { return m_cols[0] * d.X() + m_cols[1] * d.Y(); }
+
+    constexpr Vec2<TVec> operator*(const Vec2<TVec>& p) const { return transformPoint(p); }
+
+    constexpr Mat3x2 operator*(const Mat3x2& val) const
+    {
+        return Mat3x2{transformDir(val[0]), transformDir(val[1]), transformPoint(val[2])};
+    }
+    constexpr Mat3x2& operator*=(const Mat3x2& val) { return *this = *this * val; }
+
+private:
+    std::array<Vec2<TVec>, 3> m_cols;
+};
+
+template <typename TVec> class Mat3 {
+    static_assert(std::is_same_v<TVec, int> || std::is_same_v<TVec, float>);
+
+public:
+    // Ctor
+    constexpr Mat3() : Mat3(TVec{1}) { }
+    constexpr explicit Mat3(TVec diag) : m_cols{Vec3<TVec>{diag, 0, 0}, Vec3<TVec>{0, diag, 0}, Vec3<TVec>{0, 0, diag}} { }
+    constexpr Mat3(const Vec3<TVec>& c0, const Vec3<TVec>& c1, const Vec3<TVec>& c2) : m_cols{c0, c1, c2} { }
+
+    // The homogeneous form of an affine transform
+    template <typename TOther = TVec, typename = std::enable_if_t<std::is_same_v<TOther, float>>>
+    constexpr explicit Mat3(const Mat3x2<TOther>& m)
+        : m_cols{Vec3<TVec>{m[0].X(), m[0].Y(), 0}, Vec3<TVec>{m[1].X(), m[1].Y(), 0}, Vec3<TVec>{m[2].X(), m[2].Y(), 1}}
+    { }
+
+    static constexpr Mat3 translate(const Vec2<TVec>& t) { return Mat3{Mat3x2<TVec>::translate(t)}; }
+    static constexpr Mat3 scale(const Vec2<TVec>& s)     { return Mat3{Mat3x2<TVec>::scale(s)}; }
+    static constexpr Mat3 scale(TVec s)                  { return Mat3{Mat3x2<TVec>::scale(s)}; }
+
+    template <typename TPolicy = precise_t>
+    static Mat3 rotate(TVec angle, TPolicy policy = {}) { return Mat3{Mat3x2<TVec>::rotate(angle, policy)}; }
+
+    // Columns
+    constexpr const Vec3<TVec>& operator[](int n) const { return m_cols[n]; }
+    constexpr Vec3<TVec>& operator[](int n)             { return m_cols[n]; }
+
+    constexpr Mat3 transpose() const
+    {
+        return Mat3{Vec3<TVec>{m_cols[0].X(), m_cols[1].X(), m_cols[2].X()},
+                    Vec3<TVec>{m_cols[0].Y(), m_cols[1].Y(), m_cols[2].Y()},
+                    Vec3<TVec>{m_cols[0].Z(), m_cols[1].Z(), m_cols[2].Z()}};
+    }
+
+    // det() times the inverse: column i is the cross product of rows
+    // i + 1 and i + 2 of the matrix
+    constexpr Mat3 adjugate() const
+    {
+        const Mat3 rows = transpose();
+        return Mat3{cross(rows[1], rows[2]), cross(rows[2], rows[0]), cross(rows[0], rows[1])};
+    }
+
+    constexpr TVec det() const
+    {
+        return dot(m_cols[0], cross(m_cols[1], m_cols[2]));
+    }
+
+    // Stores the inverse in ret and returns the determinant; ret is left
+    // untouched when the determinant is zero
+    constexpr TVec tryInvert(Mat3& ret) const
+    {
+        static_assert(std::is_same_v<TVec, float>);
+        const TVec d = det();
+        if(d)
+        {
+            const Mat3 adj = adjugate();
+            const TVec inv = TVec{1} / d;
+            ret = Mat3{adj[0] * inv, adj[1] * inv, adj[2] * inv};
+        }
+        return d;
+    }
+
+    // The zero matrix when singular
+    constexpr Mat3 invert() const
+    {
+        Mat3 ret{TVec{0}};
+        tryInvert(ret);
+        return ret;
+    }
+
+    constexpr Vec3<TVec> operator*(const Vec3<TVec>& val) const
+    {
+        return m_cols[0] * val.X() + m_cols[1] * val.Y() + m_cols[2] * val.Z();
+    }
+
+    constexpr Mat3 operator*(const Mat3& val) const
+    {
+        return Mat3{*this * val[0], *this * val[1], *this * val[2]};
+    }
+    constexpr Mat3& operator*=(const Mat3& val) { return *this = *this * val; }
+
+private:
+    std::array<Vec3<TVec>, 3> m_cols;
+};
+
+namespace details
+{
+    // Points [begin, end) of the lanes, one SIMD register per component
+    inline void transformRange(const Mat3x2<float>& m, const Lanes<const float, 2>& src, const Lanes<float, 2>& dst,
+                               std::size_t begin, std::size_t end)
+    {
+        std::size_t n = begin;
+#if defined __AVX__ || defined __SSE2__
+        using TSimd = Simd<float>;
+        const auto xx = TSimd::broadcast(m[0].X()), xy = TSimd::broadcast(m[0].Y());
+        const auto yx = TSimd::broadcast(m[1].X()), yy = TSimd::broadcast(m[1].Y());
+        const auto tx = TSimd::broadcast(m[2].X()), ty = TSimd::broadcast(m[2].Y());
+        const std::plus<float> add;
+        const std::multiplies<float> mul;
+        for(; n + TSimd::width <= end; n += TSimd::width)
+        {
+            const auto x = TSimd::load(src[0] + n);
+            const auto y = TSimd::load(src[1] + n);
+            // Same order as Mat3x2::transformPoint(), so the results match
+            // up to FMA contraction
+            TSimd::store(dst[0] + n, TSimd::apply(TSimd::apply(TSimd::apply(xx, x, mul), TSimd::apply(yx, y, mul), add), tx, add));
+            TSimd::store(dst[1] + n, TSimd::apply(TSimd::apply(TSimd::apply(xy, x, mul), TSimd::apply(yy, y, mul), add), ty, add));
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            const Vec2<float> p = m.transformPoint(Vec2<float>{src[0][n], src[1][n]});
+            dst[0][n] = p.X();
+            dst[1][n] = p.Y();
+        }
+    }
+}
+
+// dst[n] = m * src[n]; dst may be the same array as src
+inline void transform_n(const Mat3x2<float>& m, const Vec2<float>* src, Vec2<float>* dst, std::size_t count)
+{
+    details::forEachChunk(count, [&m, src, dst](std::size_t begin, std::size_t end)
+    {
+        for(std::size_t n = begin; n < end; ++n)
+        {
+            dst[n] = m.transformPoint(src[n]);
+        }
+    });
+}
+
+inline void transform_n(const Mat3x2<float>& m, const Lanes<const float, 2>& src, const Lanes<float, 2>& dst,
+                        std::size_t count)
+{
+    details::forEachChunk(count, [&m, &src, &dst](std::size_t begin, std::size_t end)
+    {
+        details::transformRange(m, src, dst, begin, end);
+    });
+}
+
+inline void transform_n(const Mat3x2<float>& m, const Vec2Array<float>& src, Vec2Array<float>& dst)
+{
+    assert(src.size() == dst.size());
+    transform_n(m, Lanes<const float, 2>{src.X(), src.Y()}, Lanes<float, 2>{dst.X(), dst.Y()}, src.size());
+}
+
+} /* namespace lol */
+
+#endif // __LOL_MAT3_H__
@@ -0,0 +1,271 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The LooseQuadtree class
+// -----------------------
+// A 2D index for circles that move, appear and disappear. Each node
+// covers a square cell but accepts any circle whose center lies in the
+// cell and whose radius is at most half the cell size, so its loose
+// bounds are twice the cell. A circle therefore goes to a node chosen
+// from its center and radius alone, and moving it costs O(depth) at most,
+// with no rebalancing.
+//
+// Circles whose center is outside the root cell are kept in the root.
+// Nodes are created on demand and kept when they empty. Box and radius
+// queries also come in batches, split across threads.
+//
+
+#if !defined __LOL_QUADTREE_H__
+#define __LOL_QUADTREE_H__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vec.h"
+#include "vecbatch.h"
+
+namespace lol {
+
+class LooseQuadtree {
+public:
+    static constexpr std::uint32_t none = ~std::uint32_t{0};
+
+    // Ctor
+    LooseQuadtree(const Vec<float, 2>& min, float size, int maxDepth = 8) : m_maxDepth(maxDepth)
+    {
+        assert(size > 0.0f && maxDepth >= 0);
+        m_nodes.push_back(Node{min + size * 0.5f, size * 0.5f});
+    }
+
+    std::size_t size() const { return m_items.size() - m_free.size(); }
+
+    // Returns a handle that stays valid until remove()
+    std::uint32_t insert(const Vec<float, 2>& center, float radius)
+    {
+        std::uint32_t item;
+        if(m_free.empty())
+        {
+            item = static_cast<std::uint32_t>(m_items.size());
+            m_items.emplace_back();
+        }
+        else
+        {
+            item = m_free.back();
+            m_free.pop_back();
+        }
+        m_items[item].m_center = center;
+        m_items[item].m_radius = radius;
+        link(item, nodeFor(center, radius));
+        return item;
+    }
+
+    void move(std::uint32_t item, const Vec<float, 2>& center, float radius)
+    {
+        Item& data = m_items[item];
+        data.m_center = center;
+        data.m_radius = radius;
+        const std::uint32_t node = nodeFor(center, radius);
+        if(node != data.m_node)
+        {
+            unlink(item);
+            link(item, node);
+        }
+    }
+
+    void remove(std::uint32_t item)
+    {
+        unlink(item);
+        m_items[item].m_node = none;
+        m_free.push_back(item);
+    }
+
+    // Calls func(item) for each circle whose bounding box overlaps [min, max]
+    template <typename TFunc>
+    void forEachInBox(const Vec<float, 2>& min, const Vec<float, 2>& max, TFunc&& func) const
+    {
+        visit(0, min, max, [&](const Item& data)
+        {
+            return data.m_center.X() + data.m_radius >= min.X() && data.m_center.X() - data.m_radius <= max.X()
+                && data.m_center.Y() + data.m_radius >= min.Y() && data.m_center.Y() - data.m_radius <= max.Y();
+        }, func);
+    }
+
+    // Calls func(item) for each circle that intersects the given one
+    template <typename TFunc>
+    void forEachInRadius(const Vec<float, 2>& center, float radius, TFunc&& func) const
+    {
+        visit(0, center - radius, center + radius, [&](const Item& data)
+        {
+            const float reach = data.m_radius + radius;
+            return (data.m_center - center).sqlen() <= reach * reach;
+        }, func);
+    }
+
+    // forEachInBox() for each box [mins[n], maxs[n]], calling func(n, item)
+    // for query n. Large batches are split across threads like the
+    // vecbatch.h kernels: the calls for one query come from a single
+    // thread, but func must accept concurrent calls for different queries.
+    // The tree must not change meanwhile.
+    template <typename TFunc>
+    void forEachInBox_n(const Vec<float, 2>* mins, const Vec<float, 2>* maxs, std::size_t count, TFunc&& func) const
+    {
+        details::forEachChunk(count, [this, mins, maxs, &func](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                forEachInBox(mins[n], maxs[n], [&func, n](std::uint32_t item) { func(n, item); });
+            }
+        }, parallelQueries);
+    }
+
+    // forEachInRadius() for each circle of centers[n] and radii[n], with
+    // the same threading as forEachInBox_n()
+    template <typename TFunc>
+    void forEachInRadius_n(const Vec<float, 2>* centers, const float* radii, std::size_t count, TFunc&& func) const
+    {
+        details::forEachChunk(count, [this, centers, radii, &func](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t n = begin; n < end; ++n)
+            {
+                forEachInRadius(centers[n], radii[n], [&func, n](std::uint32_t item) { func(n, item); });
+            }
+        }, parallelQueries);
+    }
+
+private:
+    // Batch queries are split across threads above this many queries
+    static constexpr std::size_t parallelQueries = std::size_t{1} << 10;
+
+    struct Node
+    {
+        Vec<float, 2> m_center;
+        float m_halfSize;
+        std::uint32_t m_children = none; // the first of four, in quadrant order
+        std::uint32_t m_first = none;    // list of items
+    };
+
+    struct Item
+    {
+        Vec<float, 2> m_center;
+        float m_radius = 0.0f;
+        std::uint32_t m_node = none;
+        std::uint32_t m_prev = none, m_next = none;
+    };
+
+    // The deepest node whose cell holds the center and whose children are
+    // too small for the radius
+    std::uint32_t nodeFor(const Vec<float, 2>& center, float radius)
+    {
+        std::uint32_t node = 0;
+        const Node& root = m_nodes[0];
+        if(std::fabs(center.X() - root.m_center.X()) > root.m_halfSize
+           || std::fabs(center.Y() - root.m_center.Y()) > root.m_halfSize)
+        {
+            return node;
+        }
+
+        for(int depth = 0; depth < m_maxDepth && radius <= m_nodes[node].m_halfSize * 0.5f; ++depth)
+        {
+            if(m_nodes[node].m_children == none)
+            {
+                split(node);
+            }
+            const Node& data = m_nodes[node];
+            const std::uint32_t quadrant = (center.X() >= data.m_center.X() ? 1 : 0)
+                                         + (center.Y() >= data.m_center.Y() ? 2 : 0);
+            node = data.m_children + quadrant;
+        }
+        return node;
+    }
+
+    void split(std::uint32_t node)
+    {
+        const float half = m_nodes[node].m_halfSize * 0.5f;
+        const Vec<float, 2> center = m_nodes[node].m_center;
+        m_nodes[node].m_children = static_cast<std::uint32_t>(m_nodes.size());
+        for(std::uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+        {
+            const Vec<float, 2> offset{quadrant & 1 ? half : -half, quadrant & 2 ? half : -half};
+            m_nodes.push_back(Node{center + offset, half});
+        }
+    }
+
+    void link(std::uint32_t item, std::uint32_t node)
+    {
+        Item& data = m_items[item];
+        data.m_node = node;
+        data.m_prev = none;
+        data.m_next = m_nodes[node].m_first;
+        if(data.m_next != none)
+        {
+            m_items[data.m_next].m_prev = item;
+        }
+        m_nodes[node].m_first = item;
+    }
+
+    void unlink(std::uint32_t item)
+    {
+        const Item& data = m_items[item];
+        if(data.m_prev != none)
+        {
+            m_items[data.m_prev].m_next = data.m_next;
+        }
+        else
+        {
+            m_nodes[data.m_node].m_first = data.m_next;
+        }
+        if(data.m_next != none)
+        {
+            m_items[data.m_next].m_prev = data.m_prev;
+        }
+    }
+
+    // Tests the items of every node whose loose bounds overlap [min, max];
+    // the root is always tested since it also holds outside circles
+    template <typename TTest, typename TFunc>
+    void visit(std::uint32_t node, const Vec<float, 2>& min, const Vec<float, 2>& max, TTest&& test, TFunc& func) const
+    {
+        const Node& data = m_nodes[node];
+        for(std::uint32_t item = data.m_first; item != none; item = m_items[item].m_next)
+        {
+            if(test(m_items[item]))
+            {
+                func(item);
+            }
+        }
+        if(data.m_children == none)
+        {
+            return;
+        }
+        for(std::uint32_t child = data.m_children; child < data.m_children + 4; ++child)
+        {
+            const Node& box = m_nodes[child];
+            const float loose = 2.0f * box.m_halfSize;
+            if(box.m_center.X() + loose >= min.X() && box.m_center.X() - loose <= max.X()
+               && box.m_center.Y() + loose >= min.Y() && box.m_center.Y() - loose <= max.Y())
+            {
+                visit(child, min, max, test, func);
+            }
+        }
+    }
+
+    int m_maxDepth;
+    std::vector<Node> m_nodes;
+    std::vector<Item> m_items;
+    std::vector<std::uint32_t> m_free;
+};
+
+} /* namespace lol */
+
+#endif // __LOL_QUADTREE_H__
@@ -0,0 +1,254 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The SpatialHashGrid class
+// -------------------------
+// A broadphase for axis-aligned boxes in 2D or 3D. Space is divided into
+// cubic cells addressed by vec2i/vec3i coordinates, and an open-addressing
+// table maps each occupied cell to the boxes that touch it:
+//
+//     lol::SpatialHashGrid<3> grid(2.0f);
+//     grid.build(mins.data(), maxs.data(), mins.size());
+//     grid.forEachPair([&](std::uint32_t a, std::uint32_t b) { ... });
+//
+// A pair of boxes shares several cells when they overlap over more than
+// one; it is only reported from the cell that holds the lower corner of
+// their overlap, so no pair is reported twice. The cell size should be
+// about the size of a typical box: every box is stored once per cell it
+// touches.
+//
+
+#if !defined __LOL_SPATIALHASH_H__
+#define __LOL_SPATIALHASH_H__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "vec.h"
+
+namespace lol {
+
+template <std::size_t N> class SpatialHashGrid {
+    static_assert(N == 2 || N == 3);
+
+public:
+    using TCell = Vec<int, N>;
+    using TPoint = Vec<float, N>;
+
+    // Ctor
+    explicit SpatialHashGrid(float cellSize) : m_invCellSize(1.0f / cellSize)
+    {
+        assert(cellSize > 0.0f);
+    }
+
+    TCell cellOf(const TPoint& point) const
+    {
+        TCell ret;
+        for(int k = 0; k < static_cast<int>(N); ++k)
+        {
+            ret.begin()[k] = static_cast<int>(std::floor(point[k] * m_invCellSize));
+        }
+        return ret;
+    }
+
+    // Replaces the contents with the boxes [mins[n], maxs[n]], identified
+    // by their index n
+    void build(const TPoint* mins, const TPoint* maxs, std::size_t count)
+    {
+        m_mins.assign(mins, mins + count);
+        m_maxs.assign(maxs, maxs + count);
+        m_cellMins.resize(count);
+        m_cellMaxs.resize(count);
+
+        std::size_t total = 0;
+        for(std::size_t n = 0; n < count; ++n)
+        {
+            m_cellMins[n] = cellOf(mins[n]);
+            m_cellMaxs[n] = cellOf(maxs[n]);
+            std::size_t cells = 1;
+            for(int k = 0; k < static_cast<int>(N); ++k)
+            {
+                cells *= static_cast<std::size_t>(m_cellMaxs[n][k] - m_cellMins[n][k] + 1);
+            }
+            total += cells;
+        }
+
+        // At most half full, since there are at most total distinct cells
+        std::size_t capacity = 16;
+        while(capacity < 2 * total)
+        {
+            capacity *= 2;
+        }
+        m_mask = capacity - 1;
+        m_keys.assign(capacity, TCell{});
+        m_counts.assign(capacity, 0);
+        m_starts.resize(capacity);
+
+        // First pass: count the boxes of each cell, remembering the slots
+        std::vector<std::uint32_t> slots;
+        slots.reserve(total);
+        for(std::size_t n = 0; n < count; ++n)
+        {
+            forEachCell(m_cellMins[n], m_cellMaxs[n], [&](const TCell& cell)
+            {
+                const std::size_t slot = find(cell);
+                m_keys[slot] = cell;
+                ++m_counts[slot];
+                slots.push_back(static_cast<std::uint32_t>(slot));
+            });
+        }
+
+        std::uint32_t start = 0;
+        for(std::size_t slot = 0; slot < capacity; ++slot)
+        {
+            m_starts[slot] = start;
+            start += m_counts[slot];
+        }
+
+        // Second pass: each cell lists its boxes in increasing order
+        std::vector<std::uint32_t> next(m_starts);
+        m_ids.resize(total);
+        std::size_t i = 0;
+        for(std::size_t n = 0; n < count; ++n)
+        {
+            forEachCell(m_cellMins[n], m_cellMaxs[n], [&](const TCell&)
+            {
+                m_ids[next[slots[i++]]++] = static_cast<std::uint32_t>(n);
+            });
+        }
+    }
+
+    std::size_t size() const { return m_mins.size(); }
+
+    // Calls func(a, b) with a < b once for each pair of overlapping boxes
+    template <typename TFunc>
+    void forEachPair(TFunc&& func) const
+    {
+        for(std::size_t slot = 0; slot <= m_mask && !m_counts.empty(); ++slot)
+        {
+            const std::uint32_t* ids = m_ids.data() + m_starts[slot];
+            const std::uint32_t count = m_counts[slot];
+            for(std::uint32_t i = 0; i + 1 < count; ++i)
+            {
+                for(std::uint32_t j = i + 1; j < count; ++j)
+                {
+                    if(overlaps(ids[i], m_mins[ids[j]], m_maxs[ids[j]])
+                       && m_keys[slot] == maxCell(m_cellMins[ids[i]], m_cellMins[ids[j]]))
+                    {
+                        func(ids[i], ids[j]);
+                    }
+                }
+            }
+        }
+    }
+
+    // Calls func(n) once for each box that overlaps [min, max]
+    template <typename TFunc>
+    void forEachInBox(const TPoint& min, const TPoint& max, TFunc&& func) const
+    {
+        if(m_counts.empty())
+        {
+            return;
+        }
+
+        const TCell cellMin = cellOf(min);
+        forEachCell(cellMin, cellOf(max), [&](const TCell& cell)
+        {
+            const std::size_t slot = find(cell);
+            const std::uint32_t* ids = m_ids.data() + m_starts[slot];
+            for(std::uint32_t i = 0; i < m_counts[slot]; ++i)
+            {
+                if(overlaps(ids[i], min, max) && cell == maxCell(m_cellMins[ids[i]], cellMin))
+                {
+                    func(ids[i]);
+                }
+            }
+        });
+    }
+
+private:
+    // The slot of cell, or the empty slot where it would go
+    std::size_t find(const TCell& cell) const
+    {
+        std::size_t slot = std::hash<TCell>{}(cell) & m_mask;
+        while(m_counts[slot] != 0 && m_keys[slot] != cell)
+        {
+            slot = (slot + 1) & m_mask;
+        }
+        return slot;
+    }
+
+    bool overlaps(std::uint32_t n, const TPoint& min, const TPoint& max) const
+    {
+        for(int k = 0; k < static_cast<int>(N); ++k)
+        {
+            if(m_mins[n][k] > max[k] || min[k] > m_maxs[n][k])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static TCell maxCell(const TCell& lhs, const TCell& rhs)
+    {
+        TCell ret;
+        for(int k = 0; k < static_cast<int>(N); ++k)
+        {
+            ret.begin()[k] = lhs[k] > rhs[k] ? lhs[k] : rhs[k];
+        }
+        return ret;
+    }
+
+    // Visits the cells of [min, max] with the first coordinate varying
+    // fastest
+    template <typename TFunc>
+    static void forEachCell(const TCell& min, const TCell& max, TFunc&& func)
+    {
+        TCell cell = min;
+        for(;;)
+        {
+            func(cell);
+            int k = 0;
+            while(k < static_cast<int>(N) && cell[k] == max[k])
+            {
+                cell.begin()[k] = min[k];
+                ++k;
+            }
+            if(k == static_cast<int>(N))
+            {
+                return;
+            }
+            ++cell.begin()[k];
+        }
+    }
+
+    float m_invCellSize;
+    std::size_t m_mask = 0;
+
+    // Per box
+    std::vector<TPoint> m_mins, m_maxs;
+    std::vector<TCell> m_cellMins, m_cellMaxs;
+
+    // Per slot of the table, probed linearly; empty slots have no boxes.
+    // The boxes of the cell in slot s are m_ids[m_starts[s]] onwards.
+    std::vector<TCell> m_keys;
+    std::vector<std::uint32_t> m_starts, m_counts;
+    std::vector<std::uint32_t> m_ids;
+};
+
+} /* namespace lol */
+
+#endif // __LOL_SPATIALHASH_H__
@@ -0,0 +1,399 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The Vec class
+// -------------
+// Vec2, Vec3 and Vec4 are aliases of Vec<TVec, N>. Every component-wise
+// operation is expanded over an index_sequence, so it compiles to
+// straight-line code instead of a loop over N.
+//
+
+#if !defined __LOL_VEC_H__
+#define __LOL_VEC_H__
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "../original/ctmath.h"
+#include "fastmath.h"
+#include "vecfwd.h"
+
+namespace lol {
+
+namespace details
+{
+    template <typename TFrom, typename TTo, typename = void>
+    constexpr bool isNonNarrowing = false;
+    template <typename TFrom, typename TTo>
+    constexpr bool isNonNarrowing<TFrom, TTo, std::void_t<decltype(TTo{std::declval<TFrom>()})>> = true;
+
+    template <typename TFrom, typename TTo>
+    constexpr bool isComponent = isNonNarrowing<TFrom, TTo> || (std::is_integral_v<TFrom> && std::is_floating_point_v<TTo>);
+
+    template <typename TVec, std::size_t N, typename TFunc, std::size_t... Is>
+    constexpr bool compareVector(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs, TFunc&& func, std::index_sequence<Is...>)
+    {
+        return (func(lhs[Is], rhs[Is]) && ...);
+    }
+
+    template <typename TVec, std::size_t N, typename TFunc>
+    constexpr bool compareVector(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs, TFunc&& func)
+    {
+        return compareVector(lhs, rhs, func, std::make_index_sequence<N>{});
+    }
+
+    // Multiply-xorshift: each component is mixed in with a multiply by an
+    // odd constant, and the shifts bring the high bits back down to the
+    // low bits that hash tables use
+    template <typename TVec, std::size_t N, std::size_t... Is>
+    constexpr std::uint64_t hashVector(const Vec<TVec, N>& val, std::index_sequence<Is...>)
+    {
+        std::uint64_t ret = 0;
+        ((ret = (ret ^ static_cast<std::uint32_t>(val[Is])) * 0x9e3779b97f4a7c15ull, ret ^= ret >> 29), ...);
+        return ret ^ (ret >> 32);
+    }
+}
+
+template <typename TVec, std::size_t N> class Vec {
+    static_assert(std::is_same_v<TVec, int> || std::is_same_v<TVec, float>);
+    static_assert(N >= 2 && N <= 4);
+
+    using TData = std::array<TVec, N>;
+    using TIndices = std::make_index_sequence<N>;
+
+public:
+    // Ctor
+    constexpr explicit Vec(TVec val = TVec{}) : Vec(val, TIndices{}) { }
+
+    // Components that would be narrowed, such as a float for a Vec<int>,
+    // are rejected; integers are accepted for float vectors so that
+    // vec3{1, 0, 0} still works
+    template <typename... TArgs,
+              typename = std::enable_if_t<sizeof...(TArgs) == N && (details::isComponent<TArgs, TVec> && ...)>>
+    constexpr Vec(TArgs... args) : m_data{static_cast<TVec>(args)...} { }
+
+    // Indexing
+    constexpr const TVec& operator[](int n) const
+    {
+        assert(0 <= n && n < static_cast<int>(N));
+        return m_data[n];
+    }
+
+    // Accessors
+    constexpr TVec X() const { return m_data[0]; }
+    constexpr TVec Y() const { return m_data[1]; }
+    constexpr TVec Z() const { static_assert(N > 2); return m_data[2]; }
+    constexpr TVec W() const { static_assert(N > 3); return m_data[3]; }
+
+    constexpr TVec& X() { return m_data[0]; }
+    constexpr TVec& Y() { return m_data[1]; }
+    constexpr TVec& Z() { static_assert(N > 2); return m_data[2]; }
+    constexpr TVec& W() { static_assert(N > 3); return m_data[3]; }
+
+    // Iterators
+    constexpr typename TData::iterator begin() noexcept              { return m_data.begin(); }
+    constexpr typename TData::iterator end() noexcept                { return m_data.end(); }
+    constexpr typename TData::const_iterator cbegin() const noexcept { return m_data.cbegin(); }
+    constexpr typename TData::const_iterator cend() const noexcept   { return m_data.cend(); }
+
+    // Length
+    constexpr TVec sqlen() const
+    {
+        return sqlenImpl(TIndices{});
+    }
+
+    float len() const
+    {
+        return std::sqrt(static_cast<float>(sqlen()));
+    }
+
+    // See fastmath.h for the precision of the fast versions
+    float len(precise_t) const { return len(); }
+    float len(fast_t) const
+    {
+        const float sq = static_cast<float>(sqlen());
+        return sq ? sq * rsqrt(sq, fast) : 0.0f;
+    }
+
+    template <typename TPolicy = precise_t>
+    float invLen(TPolicy policy = {}) const
+    {
+        return rsqrt(static_cast<float>(sqlen()), policy);
+    }
+
+    // The zero vector is returned unchanged. Float vectors only: the scale
+    // factor of an integer vector would truncate to 0
+    template <typename TPolicy = precise_t, typename TOther = TVec,
+              typename = std::enable_if_t<std::is_floating_point_v<TOther>>>
+    Vec<TVec, N> normalize(TPolicy policy = {}) const
+    {
+        const float sq = static_cast<float>(sqlen());
+        return sq ? *this * static_cast<TVec>(rsqrt(sq, policy)) : *this;
+    }
+
+    // Casts: components are converted with static_cast, missing ones are
+    // zero and extra ones are dropped
+    template <typename TOther, std::size_t M>
+    constexpr explicit operator Vec<TOther, M>() const
+    {
+        return castImpl<TOther, M>(std::make_index_sequence<M>{});
+    }
+
+    // Vector operators
+    constexpr Vec<TVec, N>& operator+=(const Vec<TVec, N>& val) { return vectorOpImpl(val, std::plus<TVec>{}, TIndices{}); }
+    constexpr Vec<TVec, N>& operator-=(const Vec<TVec, N>& val) { return vectorOpImpl(val, std::minus<TVec>{}, TIndices{}); }
+    constexpr Vec<TVec, N>& operator*=(const Vec<TVec, N>& val) { return vectorOpImpl(val, std::multiplies<TVec>{}, TIndices{}); }
+    constexpr Vec<TVec, N>& operator/=(const Vec<TVec, N>& val) { return vectorOpImpl(val, std::divides<TVec>{}, TIndices{}); }
+
+    // Scalar operators
+    constexpr Vec<TVec, N>& operator+=(const TVec& val) { return scalarOpImpl(val, std::plus<TVec>{}, TIndices{}); }
+    constexpr Vec<TVec, N>& operator-=(const TVec& val) { return scalarOpImpl(val, std::minus<TVec>{}, TIndices{}); }
+    constexpr Vec<TVec, N>& operator*=(const TVec& val) { return scalarOpImpl(val, std::multiplies<TVec>{}, TIndices{}); }
+    constexpr Vec<TVec, N>& operator/=(const TVec& val) { return scalarOpImpl(val, std::divides<TVec>{}, TIndices{}); }
+
+private:
+    template <std::size_t... Is>
+    constexpr Vec(TVec val, std::index_sequence<Is...>) : m_data{(static_cast<void>(Is), val)...} { }
+
+    template <std::size_t I>
+    constexpr TVec componentOrZero() const
+    {
+        if constexpr (I < N)
+            return m_data[I];
+        else
+            return TVec{};
+    }
+
+    template <typename TOther, std::size_t M, std::size_t... Is>
+    constexpr Vec<TOther, M> castImpl(std::index_sequence<Is...>) const
+    {
+        return Vec<TOther, M>{static_cast<TOther>(componentOrZero<Is>())...};
+    }
+
+    template <std::size_t... Is>
+    constexpr TVec sqlenImpl(std::index_sequence<Is...>) const
+    {
+        return (TVec{} + ... + (m_data[Is] * m_data[Is]));
+    }
+
+    template <typename TFunc, std::size_t... Is>
+    constexpr Vec<TVec, N>& vectorOpImpl(const Vec<TVec, N>& val, TFunc&& func, std::index_sequence<Is...>)
+    {
+        ((m_data[Is] = func(m_data[Is], val.m_data[Is])), ...);
+        return *this;
+    }
+
+    template <typename TFunc, std::size_t... Is>
+    constexpr Vec<TVec, N>& scalarOpImpl(const TVec& val, TFunc&& func, std::index_sequence<Is...>)
+    {
+        ((m_data[Is] = func(m_data[Is], val)), ...);
+        return *this;
+    }
+
+    TData m_data{};
+};
+
+// Equality operators
+template<typename TVec, std::size_t N> constexpr bool operator==(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs)
+{
+    if constexpr (std::is_floating_point_v<TVec>)
+        return details::compareVector(lhs, rhs, [](TVec lhs, TVec rhs){ return std::fabs(lhs - rhs) <= std::numeric_limits<TVec>::epsilon(); });
+    else
+        return details::compareVector(lhs, rhs, std::equal_to<TVec>{});
+}
+template<typename TVec, std::size_t N> constexpr bool operator!=(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs) { return !(lhs == rhs); }
+
+// Comparison operators
+template<typename TVec, std::size_t N> constexpr bool operator<(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs)
+{
+    return details::compareVector(lhs, rhs, std::less<TVec>{});
+}
+template<typename TVec, std::size_t N> constexpr bool operator<=(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs) { return !(lhs > rhs); }
+template<typename TVec, std::size_t N> constexpr bool operator>=(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs) { return !(lhs < rhs); }
+template<typename TVec, std::size_t N> constexpr bool operator>(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs)  { return rhs < lhs; }
+
+// operator< above holds when all components are less, which is not a
+// strict weak ordering. Ordered containers need this comparator instead:
+//     std::map<lol::vec2i, int, lol::LexLess> cells;
+struct LexLess
+{
+    template <typename TVec, std::size_t N>
+    constexpr bool operator()(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs) const
+    {
+        for(int k = 0; k < static_cast<int>(N); ++k)
+        {
+            if(lhs[k] != rhs[k])
+            {
+                return lhs[k] < rhs[k];
+            }
+        }
+        return false;
+    }
+};
+
+// Vector operators
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator+(Vec<TVec, N> lhs, const Vec<TVec, N>& rhs) { lhs += rhs; return lhs; }
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator-(Vec<TVec, N> lhs, const Vec<TVec, N>& rhs) { lhs -= rhs; return lhs; }
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator*(Vec<TVec, N> lhs, const Vec<TVec, N>& rhs) { lhs *= rhs; return lhs; }
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator/(Vec<TVec, N> lhs, const Vec<TVec, N>& rhs) { lhs /= rhs; return lhs; }
+
+// Scalar operators
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator+(Vec<TVec, N> lhs, const TVec& rhs) { lhs += rhs; return lhs; }
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator-(Vec<TVec, N> lhs, const TVec& rhs) { lhs -= rhs; return lhs; }
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator*(Vec<TVec, N> lhs, const TVec& rhs) { lhs *= rhs; return lhs; }
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> operator/(Vec<TVec, N> lhs, const TVec& rhs) { lhs /= rhs; return lhs; }
+
+namespace details
+{
+    // a * b + c, as one fused instruction where the target has FMA; the
+    // library std::fma() is far too slow to use without it. Constant
+    // evaluation cannot call std::fma() and rounds twice.
+    template <typename TVec>
+    constexpr TVec mulAdd(TVec a, TVec b, TVec c)
+    {
+#if defined __FMA__ || defined __FP_FAST_FMAF
+        if constexpr (std::is_floating_point_v<TVec>)
+            if(!LOL_CONSTANT_EVALUATED())
+                return std::fma(a, b, c);
+#endif
+        return a * b + c;
+    }
+
+    template <typename TVec, std::size_t N, std::size_t... Is>
+    constexpr TVec dotImpl(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs, std::index_sequence<0, Is...>)
+    {
+        TVec ret = lhs[0] * rhs[0];
+        ((ret = mulAdd(lhs[Is], rhs[Is], ret)), ...);
+        return ret;
+    }
+
+    template <std::size_t I, typename TFunc, typename... TArgs>
+    constexpr auto mapComponent(TFunc& func, const TArgs&... args)
+    {
+        return func(args[I]...);
+    }
+
+    // ret[i] = func(val[i], args[i]...)
+    template <typename TVec, std::size_t N, typename TFunc, std::size_t... Is, typename... TArgs>
+    constexpr Vec<TVec, N> mapVector(TFunc&& func, std::index_sequence<Is...>, const Vec<TVec, N>& val, const TArgs&... args)
+    {
+        return Vec<TVec, N>{mapComponent<Is>(func, val, args...)...};
+    }
+}
+
+// Geometric operations. Products are accumulated with details::mulAdd(),
+// so float results differ in the last bit depending on whether the target
+// has FMA, and on such targets between constant and runtime evaluation.
+template<typename TVec, std::size_t N> constexpr TVec dot(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs)
+{
+    return details::dotImpl(lhs, rhs, std::make_index_sequence<N>{});
+}
+
+template<typename TVec> constexpr Vec3<TVec> cross(const Vec3<TVec>& lhs, const Vec3<TVec>& rhs)
+{
+    return Vec3<TVec>{details::mulAdd(lhs.Y(), rhs.Z(), -(lhs.Z() * rhs.Y())),
+                      details::mulAdd(lhs.Z(), rhs.X(), -(lhs.X() * rhs.Z())),
+                      details::mulAdd(lhs.X(), rhs.Y(), -(lhs.Y() * rhs.X()))};
+}
+
+// The Z component of the cross product of the vectors extended with Z = 0
+template<typename TVec> constexpr TVec cross(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs)
+{
+    return details::mulAdd(lhs.X(), rhs.Y(), -(lhs.Y() * rhs.X()));
+}
+
+// lhs at t = 0 and rhs at t = 1
+template<std::size_t N> inline Vec<float, N> lerp(const Vec<float, N>& lhs, const Vec<float, N>& rhs, float t)
+{
+    return details::mapVector([t](float a, float b) { return details::mulAdd(t, b - a, a); },
+                              std::make_index_sequence<N>{}, lhs, rhs);
+}
+
+// Component-wise; written so that they map to minps/maxps, which return
+// the second operand when either is NaN
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> min(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs)
+{
+    return details::mapVector([](TVec a, TVec b) { return a < b ? a : b; }, std::make_index_sequence<N>{}, lhs, rhs);
+}
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> max(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs)
+{
+    return details::mapVector([](TVec a, TVec b) { return a > b ? a : b; }, std::make_index_sequence<N>{}, lhs, rhs);
+}
+template<typename TVec, std::size_t N> inline Vec<TVec, N> abs(const Vec<TVec, N>& val)
+{
+    return details::mapVector([](TVec a) { return static_cast<TVec>(std::abs(a)); }, std::make_index_sequence<N>{}, val);
+}
+// One pass per component: composing max() and min() makes GCC branch
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> clamp(const Vec<TVec, N>& val, const Vec<TVec, N>& lo, const Vec<TVec, N>& hi)
+{
+    return details::mapVector([](TVec a, TVec l, TVec h) { const TVec t = a > l ? a : l; return t < h ? t : h; },
+                              std::make_index_sequence<N>{}, val, lo, hi);
+}
+template<typename TVec, std::size_t N> constexpr Vec<TVec, N> clamp(const Vec<TVec, N>& val, TVec lo, TVec hi)
+{
+    return clamp(val, Vec<TVec, N>{lo}, Vec<TVec, N>{hi});
+}
+
+// Reductions
+template<typename TVec, std::size_t N> constexpr TVec sum(const Vec<TVec, N>& val)
+{
+    TVec ret = val[0];
+    for(int k = 1; k < static_cast<int>(N); ++k)
+    {
+        ret += val[k];
+    }
+    return ret;
+}
+template<typename TVec, std::size_t N> constexpr TVec minElement(const Vec<TVec, N>& val)
+{
+    TVec ret = val[0];
+    for(int k = 1; k < static_cast<int>(N); ++k)
+    {
+        ret = val[k] < ret ? val[k] : ret;
+    }
+    return ret;
+}
+template<typename TVec, std::size_t N> constexpr TVec maxElement(const Vec<TVec, N>& val)
+{
+    TVec ret = val[0];
+    for(int k = 1; k < static_cast<int>(N); ++k)
+    {
+        ret = val[k] > ret ? val[k] : ret;
+    }
+    return ret;
+}
+
+} /* namespace lol */
+
+// Integer vectors only: float vectors compare equal within a tolerance,
+// which no hash can be consistent with, so std::hash stays disabled for
+// them
+namespace std {
+
+template <std::size_t N>
+struct hash<lol::Vec<int, N>>
+{
+    constexpr std::size_t operator()(const lol::Vec<int, N>& val) const
+    {
+        return static_cast<std::size_t>(lol::details::hashVector(val, std::make_index_sequence<N>{}));
+    }
+};
+
+} /* namespace std */
+
+#endif // __LOL_VEC_H__
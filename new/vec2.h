@@ -16,137 +16,289 @@
 #if !defined __LOL_MATRIX_H__
 #define __LOL_MATRIX_H__
 
-#include <array>
 #include <cassert>
-#include <cmath>
+#include <cstddef>
 #include <functional>
-#include <limits>
-#include <numeric>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
+#if defined __AVX__ || defined __SSE4_1__
+#   include <immintrin.h>
+#elif defined __SSE2__
+#   include <emmintrin.h>
+#endif
+
+#include "vec.h"
 #include "vec2fwd.h"
 
 namespace lol {
 
 namespace details
 {
+    // SIMD lanes used by the Vec2Array kernels. A lane type only provides
+    // apply() for the functors it has an instruction for; everything else
+    // goes through the scalar loop.
+    template <typename TVec>
+    struct Simd
+    {
+    };
+
+#if defined __AVX__
+    template <>
+    struct Simd<float>
+    {
+        using TReg = __m256;
+        static constexpr std::size_t width = 8;
+
+        static TReg load(const float* ptr)     { return _mm256_loadu_ps(ptr); }
+        static TReg broadcast(float val)       { return _mm256_set1_ps(val); }
+        static void store(float* ptr, TReg reg) { _mm256_storeu_ps(ptr, reg); }
+
+        static TReg apply(TReg lhs, TReg rhs, std::plus<float>)       { return _mm256_add_ps(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::minus<float>)      { return _mm256_sub_ps(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::multiplies<float>) { return _mm256_mul_ps(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::divides<float>)    { return _mm256_div_ps(lhs, rhs); }
+    };
+#elif defined __SSE2__
+    template <>
+    struct Simd<float>
+    {
+        using TReg = __m128;
+        static constexpr std::size_t width = 4;
+
+        static TReg load(const float* ptr)     { return _mm_loadu_ps(ptr); }
+        static TReg broadcast(float val)       { return _mm_set1_ps(val); }
+        static void store(float* ptr, TReg reg) { _mm_storeu_ps(ptr, reg); }
+
+        static TReg apply(TReg lhs, TReg rhs, std::plus<float>)       { return _mm_add_ps(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::minus<float>)      { return _mm_sub_ps(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::multiplies<float>) { return _mm_mul_ps(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::divides<float>)    { return _mm_div_ps(lhs, rhs); }
+    };
+#endif
+
+#if defined __AVX2__
+    template <>
+    struct Simd<int>
+    {
+        using TReg = __m256i;
+        static constexpr std::size_t width = 8;
+
+        static TReg load(const int* ptr)     { return _mm256_loadu_si256(reinterpret_cast<const TReg*>(ptr)); }
+        static TReg broadcast(int val)       { return _mm256_set1_epi32(val); }
+        static void store(int* ptr, TReg reg) { _mm256_storeu_si256(reinterpret_cast<TReg*>(ptr), reg); }
+
+        static TReg apply(TReg lhs, TReg rhs, std::plus<int>)       { return _mm256_add_epi32(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::minus<int>)      { return _mm256_sub_epi32(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::multiplies<int>) { return _mm256_mullo_epi32(lhs, rhs); }
+    };
+#elif defined __SSE2__
+    template <>
+    struct Simd<int>
+    {
+        using TReg = __m128i;
+        static constexpr std::size_t width = 4;
+
+        static TReg load(const int* ptr)     { return _mm_loadu_si128(reinterpret_cast<const TReg*>(ptr)); }
+        static TReg broadcast(int val)       { return _mm_set1_epi32(val); }
+        static void store(int* ptr, TReg reg) { _mm_storeu_si128(reinterpret_cast<TReg*>(ptr), reg); }
+
+        static TReg apply(TReg lhs, TReg rhs, std::plus<int>)       { return _mm_add_epi32(lhs, rhs); }
+        static TReg apply(TReg lhs, TReg rhs, std::minus<int>)      { return _mm_sub_epi32(lhs, rhs); }
+#   if defined __SSE4_1__
+        static TReg apply(TReg lhs, TReg rhs, std::multiplies<int>) { return _mm_mullo_epi32(lhs, rhs); }
+#   endif
+    };
+#endif
+
     template <typename TVec, typename TFunc>
-    inline bool compareVector(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs, TFunc&& func)
-    { 
-        for(int iElem = 0; iElem < 2; ++iElem)
+    constexpr auto hasSimd(int) -> decltype(Simd<TVec>::apply(Simd<TVec>::broadcast(TVec{}), Simd<TVec>::broadcast(TVec{}), TFunc{}), bool{})
+    {
+        return true;
+    }
+
+    template <typename TVec, typename TFunc>
+    constexpr bool hasSimd(...)
+    {
+        return false;
+    }
+
+    // dst[i] = func(dst[i], src[i])
+    template <typename TVec, typename TFunc>
+    inline void laneOp(TVec* dst, const TVec* src, std::size_t count, TFunc&& func)
+    {
+        std::size_t iElem = 0;
+        if constexpr (hasSimd<TVec, std::decay_t<TFunc>>(0))
         {
-            if(!func(lhs[iElem], rhs[iElem]))
+            using TSimd = Simd<TVec>;
+            for(; iElem + TSimd::width <= count; iElem += TSimd::width)
             {
-                return false;
+                TSimd::store(dst + iElem, TSimd::apply(TSimd::load(dst + iElem), TSimd::load(src + iElem), func));
             }
         }
-        return true;
+        for(; iElem < count; ++iElem)
+        {
+            dst[iElem] = func(dst[iElem], src[iElem]);
+        }
     }
-}
-
-template <typename TVec> class Vec2 {
-    static_assert(std::is_same_v<TVec, int> || std::is_same_v<TVec, float>);
 
-    using TData = std::array<TVec, 2>;
+    // dst[i] = func(dst[i], val)
+    template <typename TVec, typename TFunc>
+    inline void laneOp(TVec* dst, const TVec& val, std::size_t count, TFunc&& func)
+    {
+        std::size_t iElem = 0;
+        if constexpr (hasSimd<TVec, std::decay_t<TFunc>>(0))
+        {
+            using TSimd = Simd<TVec>;
+            const auto reg = TSimd::broadcast(val);
+            for(; iElem + TSimd::width <= count; iElem += TSimd::width)
+            {
+                TSimd::store(dst + iElem, TSimd::apply(TSimd::load(dst + iElem), reg, func));
+            }
+        }
+        for(; iElem < count; ++iElem)
+        {
+            dst[iElem] = func(dst[iElem], val);
+        }
+    }
+}
 
+// View on one element of a Vec2Array. It refers to the two lanes and
+// converts to a Vec2 whenever a real value is needed.
+template <typename TVec> class Vec2Ref {
 public:
     // Ctor
-    explicit Vec2(TVec val = TVec{}) : m_data{val, val} { }
-    Vec2(TVec _x, TVec _y) : m_data{_x, _y} { }
+    Vec2Ref(TVec& x, TVec& y) : m_x{x}, m_y{y} { }
+    Vec2Ref(const Vec2Ref&) = default;
+
+    Vec2Ref& operator=(const Vec2Ref& val)   { m_x = val.m_x; m_y = val.m_y;   return *this; }
+    Vec2Ref& operator=(const Vec2<TVec>& val) { m_x = val.X(); m_y = val.Y(); return *this; }
+
+    operator Vec2<TVec>() const { return Vec2<TVec>{m_x, m_y}; }
 
     // Indexing
-    constexpr const TVec& operator[](int n) const 
-    { 
+    constexpr const TVec& operator[](int n) const
+    {
         assert(0 <= n && n < 2);
-        return m_data[n]; 
+        return n == 0 ? m_x : m_y;
     }
 
     // Accessors
-    constexpr TVec X() const { return m_data[0]; }
-    constexpr TVec Y() const { return m_data[1]; }
-
-    constexpr TVec& X() { return m_data[0]; }
-    constexpr TVec& Y() { return m_data[1]; }
+    constexpr TVec X() const { return m_x; }
+    constexpr TVec Y() const { return m_y; }
 
-    // Iterators
-    constexpr typename TData::iterator begin() noexcept              { return m_data.begin(); }
-    constexpr typename TData::iterator end() noexcept                { return m_data.end(); }
-    constexpr typename TData::const_iterator cbegin() const noexcept { return m_data.cbegin(); }
-    constexpr typename TData::const_iterator cend() const noexcept   { return m_data.cend(); }
+    constexpr TVec& X() { return m_x; }
+    constexpr TVec& Y() { return m_y; }
 
     // Length
-    TVec sqlen() const
-    { 
-        return std::accumulate(m_data.cbegin(), m_data.cend(), TVec{});
-    } 
-    
-    float len() const
-    { 
-        return std::sqrt(static_cast<float>(sqlen()));
+    TVec sqlen() const { return Vec2<TVec>{*this}.sqlen(); }
+    float len() const  { return Vec2<TVec>{*this}.len(); }
+
+    template <typename TPolicy>
+    float len(TPolicy policy) const { return Vec2<TVec>{*this}.len(policy); }
+
+    // Vector operators
+    Vec2Ref& operator+=(const Vec2<TVec>& val) { return *this = Vec2<TVec>{*this} += val; }
+    Vec2Ref& operator-=(const Vec2<TVec>& val) { return *this = Vec2<TVec>{*this} -= val; }
+    Vec2Ref& operator*=(const Vec2<TVec>& val) { return *this = Vec2<TVec>{*this} *= val; }
+    Vec2Ref& operator/=(const Vec2<TVec>& val) { return *this = Vec2<TVec>{*this} /= val; }
+
+    // Scalar operators
+    Vec2Ref& operator+=(const TVec& val) { return *this = Vec2<TVec>{*this} += val; }
+    Vec2Ref& operator-=(const TVec& val) { return *this = Vec2<TVec>{*this} -= val; }
+    Vec2Ref& operator*=(const TVec& val) { return *this = Vec2<TVec>{*this} *= val; }
+    Vec2Ref& operator/=(const TVec& val) { return *this = Vec2<TVec>{*this} /= val; }
+
+private:
+    TVec& m_x;
+    TVec& m_y;
+};
+
+// Structure-of-arrays container of Vec2. The X and Y components are kept in
+// two contiguous lanes so that whole-array operators run through the SIMD
+// kernels instead of one Vec2 at a time.
+template <typename TVec> class Vec2Array {
+    static_assert(std::is_same_v<TVec, int> || std::is_same_v<TVec, float>);
+
+    using TLane = std::vector<TVec>;
+
+public:
+    // Ctor
+    Vec2Array() = default;
+    explicit Vec2Array(std::size_t count, const Vec2<TVec>& val = Vec2<TVec>{}) : m_x(count, val.X()), m_y(count, val.Y()) { }
+
+    // Size
+    std::size_t size() const noexcept { return m_x.size(); }
+    bool empty() const noexcept       { return m_x.empty(); }
+
+    void reserve(std::size_t count) { m_x.reserve(count); m_y.reserve(count); }
+    void resize(std::size_t count, const Vec2<TVec>& val = Vec2<TVec>{})
+    {
+        m_x.resize(count, val.X());
+        m_y.resize(count, val.Y());
     }
+    void clear() noexcept                 { m_x.clear(); m_y.clear(); }
+    void push_back(const Vec2<TVec>& val) { m_x.push_back(val.X()); m_y.push_back(val.Y()); }
+
+    // Indexing
+    Vec2Ref<TVec> operator[](std::size_t n)
+    {
+        assert(n < size());
+        return Vec2Ref<TVec>{m_x[n], m_y[n]};
+    }
+    Vec2<TVec> operator[](std::size_t n) const
+    {
+        assert(n < size());
+        return Vec2<TVec>{m_x[n], m_y[n]};
+    }
+
+    // Lanes
+    TVec* X() noexcept             { return m_x.data(); }
+    TVec* Y() noexcept             { return m_y.data(); }
+    const TVec* X() const noexcept { return m_x.data(); }
+    const TVec* Y() const noexcept { return m_y.data(); }
+
+    // Array operators
+    Vec2Array<TVec>& operator+=(const Vec2Array<TVec>& val) { return arrayOpImpl(val, std::plus<TVec>{}); }
+    Vec2Array<TVec>& operator-=(const Vec2Array<TVec>& val) { return arrayOpImpl(val, std::minus<TVec>{}); }
+    Vec2Array<TVec>& operator*=(const Vec2Array<TVec>& val) { return arrayOpImpl(val, std::multiplies<TVec>{}); }
+    Vec2Array<TVec>& operator/=(const Vec2Array<TVec>& val) { return arrayOpImpl(val, std::divides<TVec>{}); }
 
     // Vector operators
-    Vec2<TVec>& operator+=(const Vec2<TVec>& val) { *this = vectorOpImpl(val, std::plus<TVec>{});       return *this; }
-    Vec2<TVec>& operator-=(const Vec2<TVec>& val) { *this = vectorOpImpl(val, std::minus<TVec>{});      return *this; }
-    Vec2<TVec>& operator*=(const Vec2<TVec>& val) { *this = vectorOpImpl(val, std::multiplies<TVec>{}); return *this; }
-    Vec2<TVec>& operator/=(const Vec2<TVec>& val) { *this = vectorOpImpl(val, std::divides<TVec>{});    return *this; }
+    Vec2Array<TVec>& operator+=(const Vec2<TVec>& val) { return vectorOpImpl(val, std::plus<TVec>{}); }
+    Vec2Array<TVec>& operator-=(const Vec2<TVec>& val) { return vectorOpImpl(val, std::minus<TVec>{}); }
+    Vec2Array<TVec>& operator*=(const Vec2<TVec>& val) { return vectorOpImpl(val, std::multiplies<TVec>{}); }
+    Vec2Array<TVec>& operator/=(const Vec2<TVec>& val) { return vectorOpImpl(val, std::divides<TVec>{}); }
 
     // Scalar operators
-    Vec2<TVec>& operator+=(const TVec& val) { *this = scalarOpImpl(val, std::plus<TVec>{});       return *this; }
-    Vec2<TVec>& operator-=(const TVec& val) { *this = scalarOpImpl(val, std::minus<TVec>{});      return *this; }
-    Vec2<TVec>& operator*=(const TVec& val) { *this = scalarOpImpl(val, std::multiplies<TVec>{}); return *this; }
-    Vec2<TVec>& operator/=(const TVec& val) { *this = scalarOpImpl(val, std::divides<TVec>{});    return *this; }
+    Vec2Array<TVec>& operator+=(const TVec& val) { return vectorOpImpl(Vec2<TVec>{val}, std::plus<TVec>{}); }
+    Vec2Array<TVec>& operator-=(const TVec& val) { return vectorOpImpl(Vec2<TVec>{val}, std::minus<TVec>{}); }
+    Vec2Array<TVec>& operator*=(const TVec& val) { return vectorOpImpl(Vec2<TVec>{val}, std::multiplies<TVec>{}); }
+    Vec2Array<TVec>& operator/=(const TVec& val) { return vectorOpImpl(Vec2<TVec>{val}, std::divides<TVec>{}); }
 
 private:
     template<typename TFunc>
-    Vec2<TVec>& vectorOpImpl(const Vec2<TVec>& val, TFunc&& func)
+    Vec2Array<TVec>& arrayOpImpl(const Vec2Array<TVec>& val, TFunc&& func)
     {
-        std::transform(val.cbegin(), val.cend(), m_data.begin(), m_data.begin(), func);
+        assert(val.size() == size());
+        details::laneOp(m_x.data(), val.m_x.data(), size(), func);
+        details::laneOp(m_y.data(), val.m_y.data(), size(), func);
         return *this;
     }
 
     template<typename TFunc>
-    Vec2<TVec>& scalarOpImpl(const TVec& val, TFunc&& func)
+    Vec2Array<TVec>& vectorOpImpl(const Vec2<TVec>& val, TFunc&& func)
     {
-        std::transform(m_data.begin(), m_data.end(), m_data.begin(), [&func, &val](TVec elem){ return func(elem, val); });
+        details::laneOp(m_x.data(), val.X(), size(), func);
+        details::laneOp(m_y.data(), val.Y(), size(), func);
         return *this;
     }
 
-    TData m_data{};
+    TLane m_x;
+    TLane m_y;
 };
 
-// Equality operators
-inline bool operator==(const Vec2<int>& lhs, const Vec2<int>& rhs)
-{ 
-    return details::compareVector(lhs, rhs, std::equal_to<int>{});
-}
-inline bool operator==(const Vec2<float>& lhs, const Vec2<float>& rhs)
-{ 
-    return details::compareVector(lhs, rhs, [](float lhs, float rhs){ return std::fabs(lhs - rhs) > std::numeric_limits<float>::epsilon(); } );
-}
-template<typename TVec> inline bool operator!=(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs) { return !(lhs == rhs); }
-
-// Comparison operators
-template<typename TVec> inline bool operator<(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs)  
-{
-    return details::compareVector(lhs, rhs, [](TVec lhs, TVec rhs){ return lhs < rhs; });
-}
-template<typename TVec> inline bool operator<=(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs) { return !(lhs > rhs); }
-template<typename TVec> inline bool operator>=(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs) { return !(lhs < rhs); }
-template<typename TVec> inline bool operator>(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs)  { return rhs < lhs; }
-
-// Vector operators
-template<typename TVec> inline Vec2<TVec> operator+(Vec2<TVec> lhs, const Vec2<TVec>& rhs) { lhs += rhs; return lhs; }
-template<typename TVec> inline Vec2<TVec> operator-(Vec2<TVec> lhs, const Vec2<TVec>& rhs) { lhs -= rhs; return lhs; }
-template<typename TVec> inline Vec2<TVec> operator*(Vec2<TVec> lhs, const Vec2<TVec>& rhs) { lhs *= rhs; return lhs; }
-template<typename TVec> inline Vec2<TVec> operator/(Vec2<TVec> lhs, const Vec2<TVec>& rhs) { lhs /= rhs; return lhs; }
-
-// Scalar operators
-template<typename TVec> inline Vec2<TVec> operator+(Vec2<TVec> lhs, const TVec& rhs) { lhs += rhs; return lhs; }
-template<typename TVec> inline Vec2<TVec> operator-(Vec2<TVec> lhs, const TVec& rhs) { lhs -= rhs; return lhs; }
-template<typename TVec> inline Vec2<TVec> operator*(Vec2<TVec> lhs, const TVec& rhs) { lhs *= rhs; return lhs; }
-template<typename TVec> inline Vec2<TVec> operator/(Vec2<TVec> lhs, const TVec& rhs) { lhs /= rhs; return lhs; }
-
 } /* namespace lol */
 
 #endif // __LOL_MATRIX_H__
@@ -0,0 +1,232 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Vec2 expression templates
+// -------------------------
+// Opt-in lazy arithmetic. Wrapping an operand with lazy() makes the usual
+// operators build a node tree instead of a Vec2 per step; the tree is
+// evaluated component by component in a single pass when it is converted
+// to a Vec2 or assigned to an array with assign():
+//
+//     lol::assign(pos, lol::lazy(pos) + vel * dt - drag);
+//
+// Each component goes through the same operations in the same order as
+// the eager operators, so results are identical. Nodes keep references to
+// their Vec2 and array operands: evaluate them within the full expression
+// that builds them.
+//
+
+#if !defined __LOL_VEC2EXPR_H__
+#define __LOL_VEC2EXPR_H__
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "vec2.h"
+
+namespace lol {
+
+namespace expr
+{
+    template <typename TDerived>
+    struct Expr
+    {
+        const TDerived& self() const { return static_cast<const TDerived&>(*this); }
+    };
+
+    // A single Vec2, broadcast to every index
+    template <typename TVec>
+    class VecTerm : public Expr<VecTerm<TVec>>
+    {
+    public:
+        using TValue = TVec;
+
+        explicit VecTerm(const Vec2<TVec>& val) : m_val{val} { }
+
+        TVec x(std::size_t) const    { return m_val.X(); }
+        TVec y(std::size_t) const    { return m_val.Y(); }
+        std::size_t size() const     { return 0; }
+
+    private:
+        const Vec2<TVec>& m_val;
+    };
+
+    // A scalar, broadcast to every component of every index
+    template <typename TVec>
+    class ScalarTerm : public Expr<ScalarTerm<TVec>>
+    {
+    public:
+        using TValue = TVec;
+
+        explicit ScalarTerm(const TVec& val) : m_val{val} { }
+
+        TVec x(std::size_t) const    { return m_val; }
+        TVec y(std::size_t) const    { return m_val; }
+        std::size_t size() const     { return 0; }
+
+    private:
+        TVec m_val;
+    };
+
+    // One element per index, read from the lanes of a Vec2Array
+    template <typename TVec>
+    class ArrayTerm : public Expr<ArrayTerm<TVec>>
+    {
+    public:
+        using TValue = TVec;
+
+        explicit ArrayTerm(const Vec2Array<TVec>& val) : m_val{val} { }
+
+        TVec x(std::size_t n) const  { return m_val.X()[n]; }
+        TVec y(std::size_t n) const  { return m_val.Y()[n]; }
+        std::size_t size() const     { return m_val.size(); }
+
+    private:
+        const Vec2Array<TVec>& m_val;
+    };
+
+    // One element per index, read from an array of Vec2
+    template <typename TVec>
+    class VectorTerm : public Expr<VectorTerm<TVec>>
+    {
+    public:
+        using TValue = TVec;
+
+        explicit VectorTerm(const std::vector<Vec2<TVec>>& val) : m_val{val} { }
+
+        TVec x(std::size_t n) const  { return m_val[n].X(); }
+        TVec y(std::size_t n) const  { return m_val[n].Y(); }
+        std::size_t size() const     { return m_val.size(); }
+
+    private:
+        const std::vector<Vec2<TVec>>& m_val;
+    };
+
+    template <typename TLhs, typename TRhs, typename TFunc>
+    class BinaryNode : public Expr<BinaryNode<TLhs, TRhs, TFunc>>
+    {
+    public:
+        using TValue = typename TLhs::TValue;
+
+        BinaryNode(const TLhs& lhs, const TRhs& rhs) : m_lhs{lhs}, m_rhs{rhs}
+        {
+            assert(!lhs.size() || !rhs.size() || lhs.size() == rhs.size());
+        }
+
+        TValue x(std::size_t n) const { return TFunc{}(m_lhs.x(n), m_rhs.x(n)); }
+        TValue y(std::size_t n) const { return TFunc{}(m_lhs.y(n), m_rhs.y(n)); }
+        std::size_t size() const      { return m_lhs.size() ? m_lhs.size() : m_rhs.size(); }
+
+        // Only expressions without array operands reduce to a single Vec2
+        operator Vec2<TValue>() const
+        {
+            assert(size() == 0);
+            return Vec2<TValue>{x(0), y(0)};
+        }
+
+    private:
+        TLhs m_lhs;
+        TRhs m_rhs;
+    };
+
+#define LOL_EXPR_OPERATOR(op, func)                                                                    \
+    template <typename TLhs, typename TRhs>                                                            \
+    inline BinaryNode<TLhs, TRhs, func<typename TLhs::TValue>>                                         \
+    operator op(const Expr<TLhs>& lhs, const Expr<TRhs>& rhs)                                          \
+    {                                                                                                  \
+        return {lhs.self(), rhs.self()};                                                               \
+    }                                                                                                  \
+    template <typename TLhs>                                                                           \
+    inline BinaryNode<TLhs, VecTerm<typename TLhs::TValue>, func<typename TLhs::TValue>>               \
+    operator op(const Expr<TLhs>& lhs, const Vec2<typename TLhs::TValue>& rhs)                         \
+    {                                                                                                  \
+        return {lhs.self(), VecTerm<typename TLhs::TValue>{rhs}};                                      \
+    }                                                                                                  \
+    template <typename TRhs>                                                                           \
+    inline BinaryNode<VecTerm<typename TRhs::TValue>, TRhs, func<typename TRhs::TValue>>               \
+    operator op(const Vec2<typename TRhs::TValue>& lhs, const Expr<TRhs>& rhs)                         \
+    {                                                                                                  \
+        return {VecTerm<typename TRhs::TValue>{lhs}, rhs.self()};                                      \
+    }                                                                                                  \
+    template <typename TLhs>                                                                           \
+    inline BinaryNode<TLhs, ScalarTerm<typename TLhs::TValue>, func<typename TLhs::TValue>>            \
+    operator op(const Expr<TLhs>& lhs, const typename TLhs::TValue& rhs)                               \
+    {                                                                                                  \
+        return {lhs.self(), ScalarTerm<typename TLhs::TValue>{rhs}};                                   \
+    }                                                                                                  \
+    template <typename TRhs>                                                                           \
+    inline BinaryNode<ScalarTerm<typename TRhs::TValue>, TRhs, func<typename TRhs::TValue>>            \
+    operator op(const typename TRhs::TValue& lhs, const Expr<TRhs>& rhs)                               \
+    {                                                                                                  \
+        return {ScalarTerm<typename TRhs::TValue>{lhs}, rhs.self()};                                   \
+    }
+
+    LOL_EXPR_OPERATOR(+, std::plus)
+    LOL_EXPR_OPERATOR(-, std::minus)
+    LOL_EXPR_OPERATOR(*, std::multiplies)
+    LOL_EXPR_OPERATOR(/, std::divides)
+
+#undef LOL_EXPR_OPERATOR
+}
+
+// Entry points
+template <typename TVec> inline expr::VecTerm<TVec>    lazy(const Vec2<TVec>& val)              { return expr::VecTerm<TVec>{val}; }
+template <typename TVec> inline expr::ArrayTerm<TVec>  lazy(const Vec2Array<TVec>& val)         { return expr::ArrayTerm<TVec>{val}; }
+template <typename TVec> inline expr::VectorTerm<TVec> lazy(const std::vector<Vec2<TVec>>& val) { return expr::VectorTerm<TVec>{val}; }
+
+// Evaluation, one fused pass over every index. dst may also appear in the
+// expression since each index only reads its own elements.
+template <typename TVec, typename TExpr>
+inline void assign(Vec2Array<TVec>& dst, const expr::Expr<TExpr>& val)
+{
+    const TExpr& node = val.self();
+    assert(!node.size() || node.size() == dst.size());
+
+    TVec* x = dst.X();
+    TVec* y = dst.Y();
+    for(std::size_t iElem = 0; iElem < dst.size(); ++iElem)
+    {
+        const TVec valX = node.x(iElem);
+        const TVec valY = node.y(iElem);
+        x[iElem] = valX;
+        y[iElem] = valY;
+    }
+}
+
+template <typename TVec, typename TExpr>
+inline void assign(std::vector<Vec2<TVec>>& dst, const expr::Expr<TExpr>& val)
+{
+    const TExpr& node = val.self();
+    assert(!node.size() || node.size() == dst.size());
+
+    for(std::size_t iElem = 0; iElem < dst.size(); ++iElem)
+    {
+        const TVec valX = node.x(iElem);
+        const TVec valY = node.y(iElem);
+        dst[iElem].X() = valX;
+        dst[iElem].Y() = valY;
+    }
+}
+
+template <typename TVec, typename TExpr>
+inline void assign(Vec2<TVec>& dst, const expr::Expr<TExpr>& val)
+{
+    const TExpr& node = val.self();
+    assert(!node.size());
+
+    dst = Vec2<TVec>{node.x(0), node.y(0)};
+}
+
+} /* namespace lol */
+
+#endif // __LOL_VEC2EXPR_H__
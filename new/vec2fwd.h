@@ -1,14 +1,19 @@
 #ifndef __LOL_VEC2FWD_H__
 #define __LOL_VEC2FWD_H__
 
+#include "vecfwd.h"
+
 namespace lol
 {
 
 template<typename T>
-class Vec2;
+class Vec2Ref;
+
+template<typename T>
+class Vec2Array;
 
-using vec2 = Vec2<float>;
-using vec2i = Vec2<int>;
+using vec2array = Vec2Array<float>;
+using vec2iarray = Vec2Array<int>;
 
 } /* namespace lol */
 
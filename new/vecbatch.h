@@ -0,0 +1,1088 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Batch vector kernels
+// --------------------
+// sqlen_n, len_n, normalize_n, dot_n and distance_n compute one result per
+// element of an array of Vec2, Vec3 or Vec4, and cross_n, lerp_n, min_n,
+// max_n, abs_n and clamp_n apply the vec.h functions of the same name.
+// The input is either an array of vectors (AoS) or one array per
+// component passed as Lanes (SoA):
+//
+//     lol::len_n(positions.data(), lengths.data(), positions.size());
+//     lol::len_n(lol::Lanes<const float, 3>{xs, ys, zs}, lengths.data(), count);
+//
+// With AVX2, float inputs are processed eight elements at a time; the
+// other types are processed one element at a time. Squared lengths and
+// dot products are accumulated as lol::dot() does, and cross_n and lerp_n
+// use the multiply-adds of cross() and lerp(), fused where the target has
+// FMA. Every kernel matches its vec.h function bit for bit, and the
+// precise lengths match the members up to that contraction. dst may be
+// the same array as src. Inputs of at least details::parallelThreshold
+// elements are split across a pool of std::thread::hardware_concurrency()
+// threads, started by the first such call and reused by the later ones.
+//
+
+#if !defined __LOL_VECBATCH_H__
+#define __LOL_VECBATCH_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined __AVX2__
+#   include <immintrin.h>
+#endif
+
+#include "fastmath.h"
+#include "vec.h"
+#include "vec2.h"
+
+namespace lol {
+
+// One pointer per component, for structure-of-arrays inputs and outputs
+template <typename TVec, std::size_t N>
+using Lanes = std::array<TVec*, N>;
+
+namespace details
+{
+    // Set while a thread runs chunks of a ChunkPool job
+    inline thread_local bool inChunkJob = false;
+
+    // Worker threads shared by every batch call. They are started on the
+    // first call that goes parallel and live until exit, so later calls
+    // only pay for waking them. One job runs at a time; a call made from
+    // inside a job runs on the calling thread.
+    class ChunkPool
+    {
+    public:
+        static ChunkPool& instance()
+        {
+            static ChunkPool pool;
+            return pool;
+        }
+
+        ChunkPool(const ChunkPool&) = delete;
+        ChunkPool& operator=(const ChunkPool&) = delete;
+
+        ~ChunkPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_quit = true;
+            }
+            m_wake.notify_all();
+            for(auto& worker : m_workers)
+            {
+                worker.join();
+            }
+        }
+
+        // Threads that take part in a job, the caller included
+        std::size_t threads() const { return m_workers.size() + 1; }
+
+        // Calls func(begin, end) on [0, count) cut in chunks of chunk
+        // elements and returns once they are all done. The first exception
+        // thrown by func is rethrown here, after the other threads stopped.
+        template <typename TFunc>
+        void run(std::size_t count, std::size_t chunk, const TFunc& func)
+        {
+            if(inChunkJob || m_workers.empty())
+            {
+                func(std::size_t{0}, count);
+                return;
+            }
+
+            std::lock_guard<std::mutex> submit(m_submit);
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_job = &call<TFunc>;
+                m_ctx = &func;
+                m_count = count;
+                m_chunk = chunk;
+                m_next.store(0, std::memory_order_relaxed);
+                m_busy = m_workers.size();
+                ++m_generation;
+            }
+            m_wake.notify_all();
+
+            work();
+
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_done.wait(lock, [this] { return m_busy == 0; });
+            if(m_error)
+            {
+                std::rethrow_exception(std::exchange(m_error, nullptr));
+            }
+        }
+
+    private:
+        using TJob = void (*)(const void* ctx, std::size_t begin, std::size_t end);
+
+        template <typename TFunc>
+        static void call(const void* ctx, std::size_t begin, std::size_t end)
+        {
+            (*static_cast<const TFunc*>(ctx))(begin, end);
+        }
+
+        // Fewer workers if the system refuses to start more
+        ChunkPool()
+        {
+            const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+            m_workers.reserve(threads - 1);
+            for(unsigned n = 1; n < threads; ++n)
+            {
+                try
+                {
+                    m_workers.emplace_back(&ChunkPool::worker, this);
+                }
+                catch(const std::system_error&)
+                {
+                    break;
+                }
+            }
+        }
+
+        void worker()
+        {
+            std::size_t seen = 0;
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_lock);
+                    m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+                    if(m_quit)
+                    {
+                        return;
+                    }
+                    seen = m_generation;
+                }
+
+                work();
+
+                std::lock_guard<std::mutex> lock(m_lock);
+                if(--m_busy == 0)
+                {
+                    m_done.notify_one();
+                }
+            }
+        }
+
+        void work()
+        {
+            inChunkJob = true;
+            try
+            {
+                for(std::size_t begin; (begin = m_next.fetch_add(m_chunk, std::memory_order_relaxed)) < m_count;)
+                {
+                    m_job(m_ctx, begin, std::min(begin + m_chunk, m_count));
+                }
+            }
+            catch(...)
+            {
+                // No more chunks for anyone
+                m_next.store(m_count, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(m_lock);
+                if(!m_error)
+                {
+                    m_error = std::current_exception();
+                }
+            }
+            inChunkJob = false;
+        }
+
+        std::vector<std::thread> m_workers;
+        std::mutex m_submit, m_lock;
+        std::condition_variable m_wake, m_done;
+        std::size_t m_generation = 0, m_busy = 0;
+        bool m_quit = false;
+
+        // Current job
+        TJob m_job = nullptr;
+        const void* m_ctx = nullptr;
+        std::size_t m_count = 0, m_chunk = 0;
+        std::atomic<std::size_t> m_next{0};
+        std::exception_ptr m_error;
+    };
+
+    // Below this many elements waking the ChunkPool workers is not repaid.
+    // The first parallel call also starts them, which costs a thread
+    // creation per hardware thread once per process.
+    inline constexpr std::size_t parallelThreshold = std::size_t{1} << 18;
+
+    // Runs func(begin, end) over [0, count), on several threads for large
+    // counts. Chunks are multiples of 8 elements so that only the last one
+    // has a scalar tail. Costlier elements can use a lower threshold.
+    template <typename TFunc>
+    inline void forEachChunk(std::size_t count, TFunc&& func, std::size_t threshold = parallelThreshold)
+    {
+        if(count < threshold)
+        {
+            func(std::size_t{0}, count);
+            return;
+        }
+
+        ChunkPool& pool = ChunkPool::instance();
+        const std::size_t threads = std::min(pool.threads(), count / std::max(threshold / 2, std::size_t{1}));
+        if(threads <= 1)
+        {
+            func(std::size_t{0}, count);
+            return;
+        }
+
+        const std::size_t chunk = ((count + threads - 1) / threads + 7) & ~std::size_t{7};
+        pool.run(count, chunk, func);
+    }
+
+    // Element access for both layouts
+    template <typename TVec, std::size_t N>
+    inline Vec<TVec, N> element(const Vec<TVec, N>* src, std::size_t n)
+    {
+        return src[n];
+    }
+
+    template <typename TVec, std::size_t N, std::size_t... Is>
+    inline Vec<TVec, N> element(const Lanes<const TVec, N>& src, std::size_t n, std::index_sequence<Is...>)
+    {
+        return Vec<TVec, N>{src[Is][n]...};
+    }
+
+    template <typename TVec, std::size_t N>
+    inline Vec<TVec, N> element(const Lanes<const TVec, N>& src, std::size_t n)
+    {
+        return element(src, n, std::make_index_sequence<N>{});
+    }
+
+    template <typename TVec, std::size_t N>
+    inline void setElement(Vec<TVec, N>* dst, std::size_t n, const Vec<TVec, N>& val)
+    {
+        dst[n] = val;
+    }
+
+    template <typename TVec, std::size_t N>
+    inline void setElement(const Lanes<TVec, N>& dst, std::size_t n, const Vec<TVec, N>& val)
+    {
+        for(std::size_t k = 0; k < N; ++k)
+        {
+            dst[k][n] = val[static_cast<int>(k)];
+        }
+    }
+
+    template <typename TVec>
+    inline void setElement(TVec* dst, std::size_t n, const TVec& val)
+    {
+        dst[n] = val;
+    }
+
+    // Vec::len() and Vec::normalize() from dot(val, val) rather than
+    // sqlen(), for the scalar tails of the eight-wide loops
+    template <typename TVec, std::size_t N>
+    inline float lenOne(const Vec<TVec, N>& val, precise_t)
+    {
+        return std::sqrt(static_cast<float>(dot(val, val)));
+    }
+
+    template <typename TVec, std::size_t N>
+    inline float lenOne(const Vec<TVec, N>& val, fast_t)
+    {
+        const float sq = static_cast<float>(dot(val, val));
+        return sq ? sq * rsqrt(sq, fast) : 0.0f;
+    }
+
+    template <typename TVec, std::size_t N, typename TPolicy>
+    inline Vec<TVec, N> normalizeOne(const Vec<TVec, N>& val, TPolicy policy)
+    {
+        const float sq = static_cast<float>(dot(val, val));
+        return sq ? val * static_cast<TVec>(rsqrt(sq, policy)) : val;
+    }
+
+#if defined __AVX2__
+    // Eight vectors with one register per component, in element order.
+    // Not a std::array, which would drop the alignment of __m256.
+    template <std::size_t N>
+    struct Block
+    {
+        __m256& operator[](std::size_t k)             { return m_regs[k]; }
+        const __m256& operator[](std::size_t k) const { return m_regs[k]; }
+
+        __m256 m_regs[N];
+    };
+
+    inline Block<2> loadBlock(const Vec<float, 2>* src, std::size_t n)
+    {
+        const float* ptr = &src[n][0];
+        const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        const __m256 lo = _mm256_permutevar8x32_ps(_mm256_loadu_ps(ptr), idx);
+        const __m256 hi = _mm256_permutevar8x32_ps(_mm256_loadu_ps(ptr + 8), idx);
+        return {{_mm256_permute2f128_ps(lo, hi, 0x20), _mm256_permute2f128_ps(lo, hi, 0x31)}};
+    }
+
+    // Component k of element j sits at position 3j + k of the three
+    // registers: the blends gather the positions of one component, which
+    // never collide, and a permute puts them in element order
+    inline Block<3> loadBlock(const Vec<float, 3>* src, std::size_t n)
+    {
+        const float* ptr = &src[n][0];
+        const __m256 r0 = _mm256_loadu_ps(ptr);
+        const __m256 r1 = _mm256_loadu_ps(ptr + 8);
+        const __m256 r2 = _mm256_loadu_ps(ptr + 16);
+        const __m256 x = _mm256_blend_ps(_mm256_blend_ps(r0, r1, 0x92), r2, 0x24);
+        const __m256 y = _mm256_blend_ps(_mm256_blend_ps(r0, r1, 0x24), r2, 0x49);
+        const __m256 z = _mm256_blend_ps(_mm256_blend_ps(r0, r1, 0x49), r2, 0x92);
+        return {{_mm256_permutevar8x32_ps(x, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5)),
+                 _mm256_permutevar8x32_ps(y, _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6)),
+                 _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7))}};
+    }
+
+    // 4x4 transposes in each half give elements 0 2 4 6 | 1 3 5 7
+    inline Block<4> loadBlock(const Vec<float, 4>* src, std::size_t n)
+    {
+        const float* ptr = &src[n][0];
+        const __m256 r0 = _mm256_loadu_ps(ptr);
+        const __m256 r1 = _mm256_loadu_ps(ptr + 8);
+        const __m256 r2 = _mm256_loadu_ps(ptr + 16);
+        const __m256 r3 = _mm256_loadu_ps(ptr + 24);
+        const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+        const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+        const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+        const __m256i idx = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        return {{_mm256_permutevar8x32_ps(_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), idx),
+                 _mm256_permutevar8x32_ps(_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)), idx),
+                 _mm256_permutevar8x32_ps(_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), idx),
+                 _mm256_permutevar8x32_ps(_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)), idx)}};
+    }
+
+    template <std::size_t N>
+    inline Block<N> loadBlock(const Lanes<const float, N>& src, std::size_t n)
+    {
+        Block<N> ret;
+        for(std::size_t k = 0; k < N; ++k)
+        {
+            ret[k] = _mm256_loadu_ps(src[k] + n);
+        }
+        return ret;
+    }
+
+    // The inverses of loadBlock(), and a plain store for scalar results
+    inline void storeBlock(Vec<float, 2>* dst, std::size_t n, const Block<2>& val)
+    {
+        float* ptr = &dst[n].X();
+        const __m256i idx = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        _mm256_storeu_ps(ptr, _mm256_permutevar8x32_ps(_mm256_permute2f128_ps(val[0], val[1], 0x20), idx));
+        _mm256_storeu_ps(ptr + 8, _mm256_permutevar8x32_ps(_mm256_permute2f128_ps(val[0], val[1], 0x31), idx));
+    }
+
+    // Each component goes back to positions 3j + k, then the blends of
+    // loadBlock() pick them for each register
+    inline void storeBlock(Vec<float, 3>* dst, std::size_t n, const Block<3>& val)
+    {
+        float* ptr = &dst[n].X();
+        const __m256 x = _mm256_permutevar8x32_ps(val[0], _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+        const __m256 y = _mm256_permutevar8x32_ps(val[1], _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2));
+        const __m256 z = _mm256_permutevar8x32_ps(val[2], _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+        _mm256_storeu_ps(ptr, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x92), z, 0x24));
+        _mm256_storeu_ps(ptr + 8, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x24), z, 0x49));
+        _mm256_storeu_ps(ptr + 16, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x49), z, 0x92));
+    }
+
+    // Back in 0 2 4 6 | 1 3 5 7 order, the 4x4 transposes undo themselves
+    inline void storeBlock(Vec<float, 4>* dst, std::size_t n, const Block<4>& val)
+    {
+        float* ptr = &dst[n].X();
+        const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        const __m256 x = _mm256_permutevar8x32_ps(val[0], idx);
+        const __m256 y = _mm256_permutevar8x32_ps(val[1], idx);
+        const __m256 z = _mm256_permutevar8x32_ps(val[2], idx);
+        const __m256 w = _mm256_permutevar8x32_ps(val[3], idx);
+        const __m256 t0 = _mm256_unpacklo_ps(x, y);
+        const __m256 t1 = _mm256_unpackhi_ps(x, y);
+        const __m256 t2 = _mm256_unpacklo_ps(z, w);
+        const __m256 t3 = _mm256_unpackhi_ps(z, w);
+        _mm256_storeu_ps(ptr, _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)));
+        _mm256_storeu_ps(ptr + 8, _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)));
+        _mm256_storeu_ps(ptr + 16, _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+        _mm256_storeu_ps(ptr + 24, _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+    }
+
+    template <std::size_t N>
+    inline void storeBlock(const Lanes<float, N>& dst, std::size_t n, const Block<N>& val)
+    {
+        for(std::size_t k = 0; k < N; ++k)
+        {
+            _mm256_storeu_ps(dst[k] + n, val[k]);
+        }
+    }
+
+    inline void storeBlock(float* dst, std::size_t n, __m256 val)
+    {
+        _mm256_storeu_ps(dst + n, val);
+    }
+
+    // Register k of N AoS registers holds components of elements
+    // (8k + l) / N for l in [0, 8)
+    template <std::size_t N, std::size_t... Is>
+    constexpr std::array<int, 8 * N> makeSpread(std::index_sequence<Is...>)
+    {
+        return {{static_cast<int>(Is / N)...}};
+    }
+
+    template <std::size_t N>
+    inline constexpr std::array<int, 8 * N> spread = makeSpread<N>(std::make_index_sequence<8 * N>{});
+
+    // dst = src * scale, with one scale per element
+    template <std::size_t N>
+    inline void scaleBlock(const Vec<float, N>* src, Vec<float, N>* dst, std::size_t n, __m256 scale)
+    {
+        const float* in = &src[n][0];
+        float* out = &dst[n].X();
+        __m256 regs[N];
+        for(std::size_t k = 0; k < N; ++k)
+        {
+            regs[k] = _mm256_loadu_ps(in + 8 * k);
+        }
+        for(std::size_t k = 0; k < N; ++k)
+        {
+            const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(spread<N>.data() + 8 * k));
+            _mm256_storeu_ps(out + 8 * k, _mm256_mul_ps(regs[k], _mm256_permutevar8x32_ps(scale, idx)));
+        }
+    }
+
+    template <std::size_t N>
+    inline void scaleBlock(const Lanes<const float, N>& src, const Lanes<float, N>& dst, std::size_t n, __m256 scale)
+    {
+        for(std::size_t k = 0; k < N; ++k)
+        {
+            _mm256_storeu_ps(dst[k] + n, _mm256_mul_ps(_mm256_loadu_ps(src[k] + n), scale));
+        }
+    }
+
+    // a * b + c, fused where details::mulAdd() is
+    inline __m256 mulAddBlock(__m256 a, __m256 b, __m256 c)
+    {
+#if defined __FMA__
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+
+    // a * b - c, the same as mulAddBlock(a, b, -c)
+    inline __m256 mulSubBlock(__m256 a, __m256 b, __m256 c)
+    {
+#if defined __FMA__
+        return _mm256_fmsub_ps(a, b, c);
+#else
+        return _mm256_sub_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+
+    // ret[k] = func(args[k]...), unrolled: GCC keeps the loop over k at -O2
+    // and the blocks then go through the stack
+    template <std::size_t N, typename TFunc, std::size_t... Is, typename... TArgs>
+    inline Block<N> mapBlock(TFunc func, std::index_sequence<Is...>, const TArgs&... args)
+    {
+        return {{mapComponent<Is>(func, args...)...}};
+    }
+
+    template <std::size_t N, std::size_t... Is>
+    inline Block<N> splatBlock(const Vec<float, N>& val, std::index_sequence<Is...>)
+    {
+        return {{_mm256_set1_ps(val[Is])...}};
+    }
+
+    // Same association as details::dotImpl(): the first product, then one
+    // multiply-add per component
+    template <std::size_t N>
+    inline __m256 dotBlock(const Block<N>& lhs, const Block<N>& rhs)
+    {
+        __m256 ret = _mm256_mul_ps(lhs[0], rhs[0]);
+        for(std::size_t k = 1; k < N; ++k)
+        {
+            ret = mulAddBlock(lhs[k], rhs[k], ret);
+        }
+        return ret;
+    }
+
+    inline __m256 rsqrtBlock(__m256 val, precise_t)
+    {
+        return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(val));
+    }
+
+    inline __m256 rsqrtBlock(__m256 val, fast_t)
+    {
+        const __m256 y = _mm256_rsqrt_ps(val);
+        const __m256 t = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), val), y), y);
+        return _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), t));
+    }
+
+    inline __m256 sqrtBlock(__m256 val, precise_t)
+    {
+        return _mm256_sqrt_ps(val);
+    }
+
+    // Zero lengths are masked since rsqrt(0) is infinite
+    inline __m256 sqrtBlock(__m256 val, fast_t)
+    {
+        const __m256 nonzero = _mm256_cmp_ps(val, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+        return _mm256_and_ps(_mm256_mul_ps(val, rsqrtBlock(val, fast)), nonzero);
+    }
+
+    template <typename TVec>
+    inline constexpr bool useAvx = std::is_same_v<TVec, float>;
+#else
+    template <typename TVec>
+    inline constexpr bool useAvx = false;
+#endif
+
+    // Kernels for mapElements(): the vec.h function of one element and,
+    // with AVX2, the same operations on a Block of eight float elements
+    struct CrossOp
+    {
+        template <typename TVec>
+        Vec3<TVec> operator()(const Vec3<TVec>& lhs, const Vec3<TVec>& rhs) const
+        {
+            return cross(lhs, rhs);
+        }
+
+        template <typename TVec>
+        TVec operator()(const Vec2<TVec>& lhs, const Vec2<TVec>& rhs) const
+        {
+            return cross(lhs, rhs);
+        }
+
+#if defined __AVX2__
+        Block<3> operator()(const Block<3>& lhs, const Block<3>& rhs) const
+        {
+            return {{mulSubBlock(lhs[1], rhs[2], _mm256_mul_ps(lhs[2], rhs[1])),
+                     mulSubBlock(lhs[2], rhs[0], _mm256_mul_ps(lhs[0], rhs[2])),
+                     mulSubBlock(lhs[0], rhs[1], _mm256_mul_ps(lhs[1], rhs[0]))}};
+        }
+
+        __m256 operator()(const Block<2>& lhs, const Block<2>& rhs) const
+        {
+            return mulSubBlock(lhs[0], rhs[1], _mm256_mul_ps(lhs[1], rhs[0]));
+        }
+#endif
+    };
+
+    struct LerpOp
+    {
+        template <std::size_t N>
+        Vec<float, N> operator()(const Vec<float, N>& lhs, const Vec<float, N>& rhs) const
+        {
+            return lerp(lhs, rhs, m_t);
+        }
+
+#if defined __AVX2__
+        template <std::size_t N>
+        Block<N> operator()(const Block<N>& lhs, const Block<N>& rhs) const
+        {
+            const __m256 t = _mm256_set1_ps(m_t);
+            return mapBlock<N>([t](__m256 a, __m256 b) { return mulAddBlock(t, _mm256_sub_ps(b, a), a); },
+                               std::make_index_sequence<N>{}, lhs, rhs);
+        }
+#endif
+
+        float m_t;
+    };
+
+    // minps and maxps return the second operand when either is NaN, as
+    // min() and max() do
+    struct MinOp
+    {
+        template <typename TVec, std::size_t N>
+        Vec<TVec, N> operator()(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs) const
+        {
+            return min(lhs, rhs);
+        }
+
+#if defined __AVX2__
+        template <std::size_t N>
+        Block<N> operator()(const Block<N>& lhs, const Block<N>& rhs) const
+        {
+            return mapBlock<N>([](__m256 a, __m256 b) { return _mm256_min_ps(a, b); }, std::make_index_sequence<N>{},
+                               lhs, rhs);
+        }
+#endif
+    };
+
+    struct MaxOp
+    {
+        template <typename TVec, std::size_t N>
+        Vec<TVec, N> operator()(const Vec<TVec, N>& lhs, const Vec<TVec, N>& rhs) const
+        {
+            return max(lhs, rhs);
+        }
+
+#if defined __AVX2__
+        template <std::size_t N>
+        Block<N> operator()(const Block<N>& lhs, const Block<N>& rhs) const
+        {
+            return mapBlock<N>([](__m256 a, __m256 b) { return _mm256_max_ps(a, b); }, std::make_index_sequence<N>{},
+                               lhs, rhs);
+        }
+#endif
+    };
+
+    struct AbsOp
+    {
+        template <typename TVec, std::size_t N>
+        Vec<TVec, N> operator()(const Vec<TVec, N>& val) const
+        {
+            return abs(val);
+        }
+
+#if defined __AVX2__
+        template <std::size_t N>
+        Block<N> operator()(const Block<N>& val) const
+        {
+            const __m256 sign = _mm256_set1_ps(-0.0f);
+            return mapBlock<N>([sign](__m256 a) { return _mm256_andnot_ps(sign, a); }, std::make_index_sequence<N>{},
+                               val);
+        }
+#endif
+    };
+
+    template <typename TVec, std::size_t N>
+    struct ClampOp
+    {
+        Vec<TVec, N> operator()(const Vec<TVec, N>& val) const
+        {
+            return clamp(val, m_lo, m_hi);
+        }
+
+#if defined __AVX2__
+        Block<N> operator()(const Block<N>& val) const
+        {
+            return mapBlock<N>([](__m256 a, __m256 lo, __m256 hi) { return _mm256_min_ps(_mm256_max_ps(a, lo), hi); },
+                               std::make_index_sequence<N>{}, val, splatBlock(m_lo, std::make_index_sequence<N>{}),
+                               splatBlock(m_hi, std::make_index_sequence<N>{}));
+        }
+#endif
+
+        Vec<TVec, N> m_lo, m_hi;
+    };
+
+    // dst[n] = func(element(srcs, n)...), through the Block overloads of
+    // func eight elements at a time when TVec is float
+    template <typename TVec, typename TDst, typename TFunc, typename... TSrcs>
+    inline void mapElements(const TDst& dst, std::size_t count, TFunc func, const TSrcs&... srcs)
+    {
+        forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+            std::size_t n = begin;
+#if defined __AVX2__
+            if constexpr (useAvx<TVec>)
+            {
+                for(; n + 8 <= end; n += 8)
+                {
+                    storeBlock(dst, n, func(loadBlock(srcs, n)...));
+                }
+            }
+#endif
+            for(; n < end; ++n)
+            {
+                setElement(dst, n, func(element(srcs, n)...));
+            }
+        });
+    }
+
+    template <typename TVec, std::size_t N, typename TSrc>
+    inline void sqlenRange(const TSrc& src, TVec* dst, std::size_t begin, std::size_t end)
+    {
+        std::size_t n = begin;
+#if defined __AVX2__
+        if constexpr (useAvx<TVec>)
+        {
+            for(; n + 8 <= end; n += 8)
+            {
+                const Block<N> val = loadBlock(src, n);
+                _mm256_storeu_ps(dst + n, dotBlock(val, val));
+            }
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            const Vec<TVec, N> val = element(src, n);
+            dst[n] = dot(val, val);
+        }
+    }
+
+    template <typename TVec, std::size_t N, typename TSrc, typename TPolicy>
+    inline void lenRange(const TSrc& src, float* dst, std::size_t begin, std::size_t end, TPolicy policy)
+    {
+        std::size_t n = begin;
+#if defined __AVX2__
+        if constexpr (useAvx<TVec>)
+        {
+            for(; n + 8 <= end; n += 8)
+            {
+                const Block<N> val = loadBlock(src, n);
+                _mm256_storeu_ps(dst + n, sqrtBlock(dotBlock(val, val), policy));
+            }
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            dst[n] = lenOne(element(src, n), policy);
+        }
+    }
+
+    template <typename TVec, std::size_t N, typename TSrc, typename TDst, typename TPolicy>
+    inline void normalizeRange(const TSrc& src, const TDst& dst, std::size_t begin, std::size_t end, TPolicy policy)
+    {
+        std::size_t n = begin;
+#if defined __AVX2__
+        if constexpr (useAvx<TVec>)
+        {
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 one = _mm256_set1_ps(1.0f);
+            for(; n + 8 <= end; n += 8)
+            {
+                const Block<N> val = loadBlock(src, n);
+                const __m256 sq = dotBlock(val, val);
+                // Zero vectors are left unchanged, as with Vec::normalize()
+                const __m256 scale = _mm256_blendv_ps(one, rsqrtBlock(sq, policy),
+                                                      _mm256_cmp_ps(sq, zero, _CMP_NEQ_UQ));
+                scaleBlock(src, dst, n, scale);
+            }
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            setElement(dst, n, normalizeOne(element(src, n), policy));
+        }
+    }
+
+    template <typename TVec, std::size_t N, typename TSrc>
+    inline void dotRange(const TSrc& lhs, const TSrc& rhs, TVec* dst, std::size_t begin, std::size_t end)
+    {
+        std::size_t n = begin;
+#if defined __AVX2__
+        if constexpr (useAvx<TVec>)
+        {
+            for(; n + 8 <= end; n += 8)
+            {
+                _mm256_storeu_ps(dst + n, dotBlock(loadBlock(lhs, n), loadBlock(rhs, n)));
+            }
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            dst[n] = dot(element(lhs, n), element(rhs, n));
+        }
+    }
+
+    template <typename TVec, std::size_t N, typename TSrc, typename TPolicy>
+    inline void distanceRange(const TSrc& lhs, const TSrc& rhs, float* dst, std::size_t begin, std::size_t end,
+                              TPolicy policy)
+    {
+        std::size_t n = begin;
+#if defined __AVX2__
+        if constexpr (useAvx<TVec>)
+        {
+            for(; n + 8 <= end; n += 8)
+            {
+                const Block<N> a = loadBlock(lhs, n);
+                const Block<N> b = loadBlock(rhs, n);
+                Block<N> diff;
+                for(std::size_t k = 0; k < N; ++k)
+                {
+                    diff[k] = _mm256_sub_ps(a[k], b[k]);
+                }
+                _mm256_storeu_ps(dst + n, sqrtBlock(dotBlock(diff, diff), policy));
+            }
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            dst[n] = lenOne(element(lhs, n) - element(rhs, n), policy);
+        }
+    }
+}
+
+// dst[n] = dot(src[n], src[n]), src[n].sqlen() up to FMA contraction
+template <typename TVec, std::size_t N>
+inline void sqlen_n(const Vec<TVec, N>* src, TVec* dst, std::size_t count)
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::sqlenRange<TVec, N>(src, dst, begin, end);
+    });
+}
+
+template <typename TVec, std::size_t N>
+inline void sqlen_n(const Lanes<const TVec, N>& src, TVec* dst, std::size_t count)
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::sqlenRange<TVec, N>(src, dst, begin, end);
+    });
+}
+
+// dst[n] = src[n].len(policy)
+template <typename TVec, std::size_t N, typename TPolicy = precise_t>
+inline void len_n(const Vec<TVec, N>* src, float* dst, std::size_t count, TPolicy policy = {})
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::lenRange<TVec, N>(src, dst, begin, end, policy);
+    });
+}
+
+template <typename TVec, std::size_t N, typename TPolicy = precise_t>
+inline void len_n(const Lanes<const TVec, N>& src, float* dst, std::size_t count, TPolicy policy = {})
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::lenRange<TVec, N>(src, dst, begin, end, policy);
+    });
+}
+
+// dst[n] = src[n].normalize(policy)
+template <typename TVec, std::size_t N, typename TPolicy = precise_t>
+inline void normalize_n(const Vec<TVec, N>* src, Vec<TVec, N>* dst, std::size_t count, TPolicy policy = {})
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::normalizeRange<TVec, N>(src, dst, begin, end, policy);
+    });
+}
+
+template <typename TVec, std::size_t N, typename TPolicy = precise_t>
+inline void normalize_n(const Lanes<const TVec, N>& src, const Lanes<TVec, N>& dst, std::size_t count,
+                        TPolicy policy = {})
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::normalizeRange<TVec, N>(src, dst, begin, end, policy);
+    });
+}
+
+// dst[n] = dot(lhs[n], rhs[n])
+template <typename TVec, std::size_t N>
+inline void dot_n(const Vec<TVec, N>* lhs, const Vec<TVec, N>* rhs, TVec* dst, std::size_t count)
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::dotRange<TVec, N>(lhs, rhs, dst, begin, end);
+    });
+}
+
+template <typename TVec, std::size_t N>
+inline void dot_n(const Lanes<const TVec, N>& lhs, const Lanes<const TVec, N>& rhs, TVec* dst, std::size_t count)
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::dotRange<TVec, N>(lhs, rhs, dst, begin, end);
+    });
+}
+
+// dst[n] = (lhs[n] - rhs[n]).len(policy)
+template <typename TVec, std::size_t N, typename TPolicy = precise_t>
+inline void distance_n(const Vec<TVec, N>* lhs, const Vec<TVec, N>* rhs, float* dst, std::size_t count,
+                       TPolicy policy = {})
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::distanceRange<TVec, N>(lhs, rhs, dst, begin, end, policy);
+    });
+}
+
+template <typename TVec, std::size_t N, typename TPolicy = precise_t>
+inline void distance_n(const Lanes<const TVec, N>& lhs, const Lanes<const TVec, N>& rhs, float* dst,
+                       std::size_t count, TPolicy policy = {})
+{
+    details::forEachChunk(count, [=](std::size_t begin, std::size_t end) {
+        details::distanceRange<TVec, N>(lhs, rhs, dst, begin, end, policy);
+    });
+}
+
+// dst[n] = cross(lhs[n], rhs[n]): a Vec3 for Vec3 inputs, a scalar for
+// Vec2 inputs
+template <typename TVec>
+inline void cross_n(const Vec3<TVec>* lhs, const Vec3<TVec>* rhs, Vec3<TVec>* dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::CrossOp{}, lhs, rhs);
+}
+
+template <typename TVec>
+inline void cross_n(const Lanes<const TVec, 3>& lhs, const Lanes<const TVec, 3>& rhs, const Lanes<TVec, 3>& dst,
+                    std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::CrossOp{}, lhs, rhs);
+}
+
+template <typename TVec>
+inline void cross_n(const Vec2<TVec>* lhs, const Vec2<TVec>* rhs, TVec* dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::CrossOp{}, lhs, rhs);
+}
+
+template <typename TVec>
+inline void cross_n(const Lanes<const TVec, 2>& lhs, const Lanes<const TVec, 2>& rhs, TVec* dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::CrossOp{}, lhs, rhs);
+}
+
+// dst[n] = lerp(lhs[n], rhs[n], t)
+template <std::size_t N>
+inline void lerp_n(const Vec<float, N>* lhs, const Vec<float, N>* rhs, float t, Vec<float, N>* dst, std::size_t count)
+{
+    details::mapElements<float>(dst, count, details::LerpOp{t}, lhs, rhs);
+}
+
+template <std::size_t N>
+inline void lerp_n(const Lanes<const float, N>& lhs, const Lanes<const float, N>& rhs, float t,
+                   const Lanes<float, N>& dst, std::size_t count)
+{
+    details::mapElements<float>(dst, count, details::LerpOp{t}, lhs, rhs);
+}
+
+// dst[n] = min(lhs[n], rhs[n]) and max(lhs[n], rhs[n])
+template <typename TVec, std::size_t N>
+inline void min_n(const Vec<TVec, N>* lhs, const Vec<TVec, N>* rhs, Vec<TVec, N>* dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::MinOp{}, lhs, rhs);
+}
+
+template <typename TVec, std::size_t N>
+inline void min_n(const Lanes<const TVec, N>& lhs, const Lanes<const TVec, N>& rhs, const Lanes<TVec, N>& dst,
+                  std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::MinOp{}, lhs, rhs);
+}
+
+template <typename TVec, std::size_t N>
+inline void max_n(const Vec<TVec, N>* lhs, const Vec<TVec, N>* rhs, Vec<TVec, N>* dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::MaxOp{}, lhs, rhs);
+}
+
+template <typename TVec, std::size_t N>
+inline void max_n(const Lanes<const TVec, N>& lhs, const Lanes<const TVec, N>& rhs, const Lanes<TVec, N>& dst,
+                  std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::MaxOp{}, lhs, rhs);
+}
+
+// dst[n] = abs(src[n])
+template <typename TVec, std::size_t N>
+inline void abs_n(const Vec<TVec, N>* src, Vec<TVec, N>* dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::AbsOp{}, src);
+}
+
+template <typename TVec, std::size_t N>
+inline void abs_n(const Lanes<const TVec, N>& src, const Lanes<TVec, N>& dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::AbsOp{}, src);
+}
+
+// dst[n] = clamp(src[n], lo, hi)
+template <typename TVec, std::size_t N>
+inline void clamp_n(const Vec<TVec, N>* src, const Vec<TVec, N>& lo, const Vec<TVec, N>& hi, Vec<TVec, N>* dst,
+                    std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::ClampOp<TVec, N>{lo, hi}, src);
+}
+
+template <typename TVec, std::size_t N>
+inline void clamp_n(const Lanes<const TVec, N>& src, const Vec<TVec, N>& lo, const Vec<TVec, N>& hi,
+                    const Lanes<TVec, N>& dst, std::size_t count)
+{
+    details::mapElements<TVec>(dst, count, details::ClampOp<TVec, N>{lo, hi}, src);
+}
+
+// Vec2Array overloads; dst holds src.size() results
+template <typename TVec>
+inline void sqlen_n(const Vec2Array<TVec>& src, TVec* dst)
+{
+    sqlen_n(Lanes<const TVec, 2>{src.X(), src.Y()}, dst, src.size());
+}
+
+template <typename TVec, typename TPolicy = precise_t>
+inline void len_n(const Vec2Array<TVec>& src, float* dst, TPolicy policy = {})
+{
+    len_n(Lanes<const TVec, 2>{src.X(), src.Y()}, dst, src.size(), policy);
+}
+
+template <typename TVec, typename TPolicy = precise_t>
+inline void normalize_n(const Vec2Array<TVec>& src, Vec2Array<TVec>& dst, TPolicy policy = {})
+{
+    assert(dst.size() == src.size());
+    normalize_n(Lanes<const TVec, 2>{src.X(), src.Y()}, Lanes<TVec, 2>{dst.X(), dst.Y()}, src.size(), policy);
+}
+
+template <typename TVec>
+inline void dot_n(const Vec2Array<TVec>& lhs, const Vec2Array<TVec>& rhs, TVec* dst)
+{
+    assert(lhs.size() == rhs.size());
+    dot_n(Lanes<const TVec, 2>{lhs.X(), lhs.Y()}, Lanes<const TVec, 2>{rhs.X(), rhs.Y()}, dst, lhs.size());
+}
+
+template <typename TVec, typename TPolicy = precise_t>
+inline void distance_n(const Vec2Array<TVec>& lhs, const Vec2Array<TVec>& rhs, float* dst, TPolicy policy = {})
+{
+    assert(lhs.size() == rhs.size());
+    distance_n(Lanes<const TVec, 2>{lhs.X(), lhs.Y()}, Lanes<const TVec, 2>{rhs.X(), rhs.Y()}, dst, lhs.size(),
+               policy);
+}
+
+template <typename TVec>
+inline void cross_n(const Vec2Array<TVec>& lhs, const Vec2Array<TVec>& rhs, TVec* dst)
+{
+    assert(lhs.size() == rhs.size());
+    cross_n(Lanes<const TVec, 2>{lhs.X(), lhs.Y()}, Lanes<const TVec, 2>{rhs.X(), rhs.Y()}, dst, lhs.size());
+}
+
+inline void lerp_n(const Vec2Array<float>& lhs, const Vec2Array<float>& rhs, float t, Vec2Array<float>& dst)
+{
+    assert(lhs.size() == rhs.size() && dst.size() == lhs.size());
+    lerp_n(Lanes<const float, 2>{lhs.X(), lhs.Y()}, Lanes<const float, 2>{rhs.X(), rhs.Y()}, t,
+           Lanes<float, 2>{dst.X(), dst.Y()}, lhs.size());
+}
+
+template <typename TVec>
+inline void min_n(const Vec2Array<TVec>& lhs, const Vec2Array<TVec>& rhs, Vec2Array<TVec>& dst)
+{
+    assert(lhs.size() == rhs.size() && dst.size() == lhs.size());
+    min_n(Lanes<const TVec, 2>{lhs.X(), lhs.Y()}, Lanes<const TVec, 2>{rhs.X(), rhs.Y()},
+          Lanes<TVec, 2>{dst.X(), dst.Y()}, lhs.size());
+}
+
+template <typename TVec>
+inline void max_n(const Vec2Array<TVec>& lhs, const Vec2Array<TVec>& rhs, Vec2Array<TVec>& dst)
+{
+    assert(lhs.size() == rhs.size() && dst.size() == lhs.size());
+    max_n(Lanes<const TVec, 2>{lhs.X(), lhs.Y()}, Lanes<const TVec, 2>{rhs.X(), rhs.Y()},
+          Lanes<TVec, 2>{dst.X(), dst.Y()}, lhs.size());
+}
+
+template <typename TVec>
+inline void abs_n(const Vec2Array<TVec>& src, Vec2Array<TVec>& dst)
+{
+    assert(dst.size() == src.size());
+    abs_n(Lanes<const TVec, 2>{src.X(), src.Y()}, Lanes<TVec, 2>{dst.X(), dst.Y()}, src.size());
+}
+
+template <typename TVec>
+inline void clamp_n(const Vec2Array<TVec>& src, const Vec2<TVec>& lo, const Vec2<TVec>& hi, Vec2Array<TVec>& dst)
+{
+    assert(dst.size() == src.size());
+    clamp_n(Lanes<const TVec, 2>{src.X(), src.Y()}, lo, hi, Lanes<TVec, 2>{dst.X(), dst.Y()}, src.size());
+}
+
+} /* namespace lol */
+
+#endif // __LOL_VECBATCH_H__
@@ -0,0 +1,50 @@
+#ifndef __LOL_VECFWD_H__
+#define __LOL_VECFWD_H__
+
+#include <cstddef>
+
+namespace lol
+{
+
+template<typename T, std::size_t N>
+class Vec;
+
+template<typename T>
+using Vec2 = Vec<T, 2>;
+template<typename T>
+using Vec3 = Vec<T, 3>;
+template<typename T>
+using Vec4 = Vec<T, 4>;
+
+using vec2 = Vec2<float>;
+using vec2i = Vec2<int>;
+using vec3 = Vec3<float>;
+using vec3i = Vec3<int>;
+using vec4 = Vec4<float>;
+using vec4i = Vec4<int>;
+
+class half;
+class snorm16;
+
+template<typename TStorage, std::size_t N>
+class PackedVec;
+
+using f16vec2 = PackedVec<half, 2>;
+using f16vec3 = PackedVec<half, 3>;
+using f16vec4 = PackedVec<half, 4>;
+using sn16vec2 = PackedVec<snorm16, 2>;
+using sn16vec3 = PackedVec<snorm16, 3>;
+using sn16vec4 = PackedVec<snorm16, 4>;
+
+template<typename T>
+class Mat3;
+template<typename T>
+class Mat3x2;
+
+using mat3 = Mat3<float>;
+using mat3i = Mat3<int>;
+using mat3x2 = Mat3x2<float>;
+
+} /* namespace lol */
+
+#endif // __LOL_VECFWD_H__
@@ -0,0 +1,337 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Packed vectors
+// --------------
+// PackedVec<TStorage, N> stores N components in 16 bits each, as IEEE
+// half floats (half) or as signed normalized integers in [-1, 1]
+// (snorm16). Packed vectors are storage only: any arithmetic unpacks them
+// to Vec<float, N> first.
+//
+// pack_n and unpack_n convert whole arrays, with F16C for half and AVX2
+// for snorm16 when available. Both round to nearest even, so the bulk and
+// per-element conversions give identical results.
+//
+//     std::vector<lol::f16vec3> normals(count);
+//     lol::pack_n(floatNormals.data(), normals.data(), count);
+//
+
+#if !defined __LOL_VECPACKED_H__
+#define __LOL_VECPACKED_H__
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if defined __AVX2__ || defined __F16C__
+#   include <immintrin.h>
+#endif
+
+#include "vec.h"
+#include "vecbatch.h"
+#include "vecfwd.h"
+
+namespace lol {
+
+namespace details
+{
+    inline std::uint32_t floatBits(float val)
+    {
+        std::uint32_t ret;
+        std::memcpy(&ret, &val, sizeof(ret));
+        return ret;
+    }
+
+    inline float bitsFloat(std::uint32_t val)
+    {
+        float ret;
+        std::memcpy(&ret, &val, sizeof(ret));
+        return ret;
+    }
+
+    // Values below the smallest normal half are rounded by the FPU when
+    // adding a magic number whose ulp is the smallest denormal half. Normal
+    // values are rebiased and rounded by hand, and a carry out of the
+    // mantissa correctly rounds up to the next exponent or to infinity.
+    inline std::uint16_t floatToHalf(float val)
+    {
+        std::uint32_t bits = floatBits(val);
+        const std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+        bits &= 0x7fffffff;
+
+        if(bits >= 0x47800000) // 65536, Inf and NaN
+        {
+            // NaNs are quieted and keep the top of their payload, like F16C
+            return sign | (bits > 0x7f800000 ? 0x7e00 | ((bits >> 13) & 0x3ff) : 0x7c00);
+        }
+        if(bits < 0x38800000) // 2^-14
+        {
+            const std::uint32_t magic = 0x3f000000; // 0.5
+            return sign | static_cast<std::uint16_t>(floatBits(bitsFloat(bits) + bitsFloat(magic)) - magic);
+        }
+        bits += 0xc8000fff + ((bits >> 13) & 1); // exponent bias 15 - 127, rounding
+        return sign | static_cast<std::uint16_t>(bits >> 13);
+    }
+
+    inline float halfToFloat(std::uint16_t val)
+    {
+        std::uint32_t bits = static_cast<std::uint32_t>(val & 0x7fff) << 13;
+        const std::uint32_t exponent = bits & 0x0f800000;
+        bits += 0x38000000; // exponent bias 127 - 15
+
+        if(exponent == 0x0f800000) // Inf and NaN, quieted like F16C
+        {
+            bits += 0x38000000;
+            bits |= (bits & 0x007fffff) ? 0x00400000 : 0;
+        }
+        else if(exponent == 0) // zero and denormals
+        {
+            bits = floatBits(bitsFloat(bits + 0x00800000) - bitsFloat(0x38800000));
+        }
+        return bitsFloat(bits | static_cast<std::uint32_t>(val & 0x8000) << 16);
+    }
+
+    // Written like the min/max instructions so that NaN encodes as -1
+    inline std::int16_t floatToSnorm16(float val)
+    {
+        val = val > -1.0f ? val : -1.0f;
+        val = val < 1.0f ? val : 1.0f;
+        return static_cast<std::int16_t>(std::nearbyint(val * 32767.0f));
+    }
+
+    // -32768 is the only code below -1 and decodes to -1
+    inline float snorm16ToFloat(std::int16_t val)
+    {
+        const float ret = static_cast<float>(val) / 32767.0f;
+        return ret > -1.0f ? ret : -1.0f;
+    }
+}
+
+// Storage types
+class half
+{
+public:
+    // Ctor
+    constexpr half() = default;
+    explicit half(float val) : m_bits(details::floatToHalf(val)) { }
+
+    static constexpr half fromBits(std::uint16_t bits)
+    {
+        half ret;
+        ret.m_bits = bits;
+        return ret;
+    }
+
+    operator float() const { return details::halfToFloat(m_bits); }
+    constexpr std::uint16_t bits() const { return m_bits; }
+
+private:
+    std::uint16_t m_bits{};
+};
+
+class snorm16
+{
+public:
+    // Ctor
+    constexpr snorm16() = default;
+    explicit snorm16(float val) : m_bits(details::floatToSnorm16(val)) { }
+
+    static constexpr snorm16 fromBits(std::int16_t bits)
+    {
+        snorm16 ret;
+        ret.m_bits = bits;
+        return ret;
+    }
+
+    operator float() const { return details::snorm16ToFloat(m_bits); }
+    constexpr std::int16_t bits() const { return m_bits; }
+
+private:
+    std::int16_t m_bits{};
+};
+
+template <typename TStorage, std::size_t N> class PackedVec {
+    static_assert(std::is_same_v<TStorage, half> || std::is_same_v<TStorage, snorm16>);
+    static_assert(N >= 2 && N <= 4);
+
+    using TData = std::array<TStorage, N>;
+    using TIndices = std::make_index_sequence<N>;
+
+public:
+    // Ctor
+    constexpr PackedVec() = default;
+    explicit PackedVec(const Vec<float, N>& val) : PackedVec(val, TIndices{}) { }
+
+    // Indexing
+    constexpr const TStorage& operator[](int n) const
+    {
+        assert(0 <= n && n < static_cast<int>(N));
+        return m_data[n];
+    }
+
+    constexpr TStorage& operator[](int n)
+    {
+        assert(0 <= n && n < static_cast<int>(N));
+        return m_data[n];
+    }
+
+    // Conversion
+    Vec<float, N> unpack() const { return unpackImpl(TIndices{}); }
+    operator Vec<float, N>() const { return unpack(); }
+
+private:
+    template <std::size_t... Is>
+    PackedVec(const Vec<float, N>& val, std::index_sequence<Is...>) : m_data{TStorage(val[Is])...} { }
+
+    template <std::size_t... Is>
+    Vec<float, N> unpackImpl(std::index_sequence<Is...>) const
+    {
+        return Vec<float, N>{static_cast<float>(m_data[Is])...};
+    }
+
+    TData m_data{};
+};
+
+// Arithmetic operators, computed on the unpacked values
+template<typename TStorage, std::size_t N> Vec<float, N> operator+(const PackedVec<TStorage, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs.unpack() + rhs.unpack(); }
+template<typename TStorage, std::size_t N> Vec<float, N> operator-(const PackedVec<TStorage, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs.unpack() - rhs.unpack(); }
+template<typename TStorage, std::size_t N> Vec<float, N> operator*(const PackedVec<TStorage, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs.unpack() * rhs.unpack(); }
+template<typename TStorage, std::size_t N> Vec<float, N> operator/(const PackedVec<TStorage, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs.unpack() / rhs.unpack(); }
+
+template<typename TStorage, std::size_t N> Vec<float, N> operator+(const PackedVec<TStorage, N>& lhs, const Vec<float, N>& rhs) { return lhs.unpack() + rhs; }
+template<typename TStorage, std::size_t N> Vec<float, N> operator-(const PackedVec<TStorage, N>& lhs, const Vec<float, N>& rhs) { return lhs.unpack() - rhs; }
+template<typename TStorage, std::size_t N> Vec<float, N> operator*(const PackedVec<TStorage, N>& lhs, const Vec<float, N>& rhs) { return lhs.unpack() * rhs; }
+template<typename TStorage, std::size_t N> Vec<float, N> operator/(const PackedVec<TStorage, N>& lhs, const Vec<float, N>& rhs) { return lhs.unpack() / rhs; }
+
+template<typename TStorage, std::size_t N> Vec<float, N> operator+(const Vec<float, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs + rhs.unpack(); }
+template<typename TStorage, std::size_t N> Vec<float, N> operator-(const Vec<float, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs - rhs.unpack(); }
+template<typename TStorage, std::size_t N> Vec<float, N> operator*(const Vec<float, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs * rhs.unpack(); }
+template<typename TStorage, std::size_t N> Vec<float, N> operator/(const Vec<float, N>& lhs, const PackedVec<TStorage, N>& rhs) { return lhs / rhs.unpack(); }
+
+template<typename TStorage, std::size_t N> Vec<float, N> operator+(const PackedVec<TStorage, N>& lhs, float rhs) { return lhs.unpack() + rhs; }
+template<typename TStorage, std::size_t N> Vec<float, N> operator-(const PackedVec<TStorage, N>& lhs, float rhs) { return lhs.unpack() - rhs; }
+template<typename TStorage, std::size_t N> Vec<float, N> operator*(const PackedVec<TStorage, N>& lhs, float rhs) { return lhs.unpack() * rhs; }
+template<typename TStorage, std::size_t N> Vec<float, N> operator/(const PackedVec<TStorage, N>& lhs, float rhs) { return lhs.unpack() / rhs; }
+
+namespace details
+{
+    // Flat conversions of count components, eight at a time when possible
+    inline void packRange(const float* src, half* dst, std::size_t begin, std::size_t end)
+    {
+        std::size_t n = begin;
+#if defined __F16C__
+        for(; n + 8 <= end; n += 8)
+        {
+            const __m128i val = _mm256_cvtps_ph(_mm256_loadu_ps(src + n), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + n), val);
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            dst[n] = half(src[n]);
+        }
+    }
+
+    inline void unpackRange(const half* src, float* dst, std::size_t begin, std::size_t end)
+    {
+        std::size_t n = begin;
+#if defined __F16C__
+        for(; n + 8 <= end; n += 8)
+        {
+            const __m128i val = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + n));
+            _mm256_storeu_ps(dst + n, _mm256_cvtph_ps(val));
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            dst[n] = src[n];
+        }
+    }
+
+    // cvtps_epi32 rounds in the current mode like std::nearbyint()
+    inline void packRange(const float* src, snorm16* dst, std::size_t begin, std::size_t end)
+    {
+        std::size_t n = begin;
+#if defined __AVX2__
+        const __m256 lo = _mm256_set1_ps(-1.0f);
+        const __m256 hi = _mm256_set1_ps(1.0f);
+        const __m256 scale = _mm256_set1_ps(32767.0f);
+        for(; n + 8 <= end; n += 8)
+        {
+            const __m256 val = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + n), lo), hi);
+            const __m256i ints = _mm256_cvtps_epi32(_mm256_mul_ps(val, scale));
+            const __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + n), packed);
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            dst[n] = snorm16(src[n]);
+        }
+    }
+
+    inline void unpackRange(const snorm16* src, float* dst, std::size_t begin, std::size_t end)
+    {
+        std::size_t n = begin;
+#if defined __AVX2__
+        const __m256 lo = _mm256_set1_ps(-1.0f);
+        const __m256 scale = _mm256_set1_ps(32767.0f);
+        for(; n + 8 <= end; n += 8)
+        {
+            const __m256i ints = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + n)));
+            _mm256_storeu_ps(dst + n, _mm256_max_ps(_mm256_div_ps(_mm256_cvtepi32_ps(ints), scale), lo));
+        }
+#endif
+        for(; n < end; ++n)
+        {
+            dst[n] = src[n];
+        }
+    }
+}
+
+// Bulk conversions of count vectors. Large arrays are split across threads
+// like the vecbatch.h kernels.
+template <typename TStorage, std::size_t N>
+void pack_n(const Vec<float, N>* src, PackedVec<TStorage, N>* dst, std::size_t count)
+{
+    static_assert(sizeof(Vec<float, N>) == N * sizeof(float));
+    static_assert(sizeof(PackedVec<TStorage, N>) == N * sizeof(TStorage));
+
+    const float* in = count ? &src[0][0] : nullptr;
+    TStorage* out = count ? &dst[0][0] : nullptr;
+    details::forEachChunk(count * N, [=](std::size_t begin, std::size_t end)
+    {
+        details::packRange(in, out, begin, end);
+    });
+}
+
+template <typename TStorage, std::size_t N>
+void unpack_n(const PackedVec<TStorage, N>* src, Vec<float, N>* dst, std::size_t count)
+{
+    static_assert(sizeof(Vec<float, N>) == N * sizeof(float));
+    static_assert(sizeof(PackedVec<TStorage, N>) == N * sizeof(TStorage));
+
+    const TStorage* in = count ? &src[0][0] : nullptr;
+    float* out = count ? &dst[0].X() : nullptr;
+    details::forEachChunk(count * N, [=](std::size_t begin, std::size_t end)
+    {
+        details::unpackRange(in, out, begin, end);
+    });
+}
+
+} /* namespace lol */
+
+#endif // __LOL_VECPACKED_H__
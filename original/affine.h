@@ -0,0 +1,177 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The Affine3 class
+// -----------------
+// A Mat4 whose last row is known to be (0, 0, 0, 1), stored as four Vec3
+// columns: the 3x3 linear part followed by the translation.
+//
+
+#if !defined __LOL_AFFINE_H__
+#define __LOL_AFFINE_H__
+
+#include "lol/matrix.h"
+
+namespace lol {
+
+template <typename T> struct Affine3 {
+  inline Affine3() {}
+  inline Affine3(T val) {
+    for (int j = 0; j < 3; j++)
+      for (int i = 0; i < 4; i++)
+        v[i][j] = (i == j) ? val : 0;
+  }
+  inline Affine3(Vec3<T> v0, Vec3<T> v1, Vec3<T> v2, Vec3<T> v3) {
+    v[0] = v0;
+    v[1] = v1;
+    v[2] = v2;
+    v[3] = v3;
+  }
+  /* The last row of mat is ignored */
+  explicit inline Affine3(Mat4<T> const &mat) {
+    for (int i = 0; i < 4; i++)
+      v[i] = Vec3<T>(mat[i].x, mat[i].y, mat[i].z);
+  }
+
+  inline operator Mat4<T>() const {
+    return Mat4<T>(Vec4<T>(v[0].x, v[0].y, v[0].z, 0),
+                   Vec4<T>(v[1].x, v[1].y, v[1].z, 0),
+                   Vec4<T>(v[2].x, v[2].y, v[2].z, 0),
+                   Vec4<T>(v[3].x, v[3].y, v[3].z, 1));
+  }
+
+  inline Vec3<T> &operator[](int n) { return v[n]; }
+  inline Vec3<T> const &operator[](int n) const { return v[n]; }
+
+  static inline Affine3<T> translate(T x, T y, T z) {
+    Affine3<T> ret(1);
+    ret[3] = Vec3<T>(x, y, z);
+    return ret;
+  }
+
+  static inline Affine3<T> scale(T x, T y, T z) {
+    Affine3<T> ret(1);
+    ret[0][0] = x;
+    ret[1][1] = y;
+    ret[2][2] = z;
+    return ret;
+  }
+
+  static inline Affine3<T> rotate(T theta, T x, T y, T z) {
+    return Affine3<T>(Mat4<T>::rotate(theta, x, y, z));
+  }
+
+  /* Determinant of the linear part */
+  inline T det() const {
+    return v[0][0] * (v[1][1] * v[2][2] - v[2][1] * v[1][2]) +
+           v[1][0] * (v[2][1] * v[0][2] - v[0][1] * v[2][2]) +
+           v[2][0] * (v[0][1] * v[1][2] - v[1][1] * v[0][2]);
+  }
+
+  /* Store the inverse in ret and return the determinant of the linear
+   * part. ret is left untouched when the determinant is zero. */
+  inline T try_invert(Affine3<T> &ret) const {
+    T d = det();
+    if (!d)
+      return d;
+
+    T invdet = (T)1 / d;
+    Affine3<T> inv;
+    for (int j = 0; j < 3; j++)
+      for (int i = 0; i < 3; i++) {
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        inv[j][i] = (v[i1][j1] * v[i2][j2] - v[i2][j1] * v[i1][j2]) * invdet;
+      }
+    inv[3] = inv.linear(v[3]) * (T)-1;
+    ret = inv;
+    return d;
+  }
+
+  inline Affine3<T> invert() const {
+    Affine3<T> ret;
+    try_invert(ret);
+    return ret;
+  }
+
+  /* Inverse of a rotation and translation only: the linear part is
+   * transposed and the translation rotated back. Any scale or shear in
+   * the linear part gives a wrong result; use invert() for those. */
+  inline Affine3<T> invert_rigid() const {
+    Affine3<T> ret;
+    for (int j = 0; j < 3; j++)
+      for (int i = 0; i < 3; i++)
+        ret[i][j] = v[j][i];
+    ret[3] = ret.linear(v[3]) * (T)-1;
+    return ret;
+  }
+
+  /* 27 multiplies for the linear part, 9 for the translation */
+  inline Affine3<T> operator*(Affine3<T> const &val) const {
+    Affine3<T> ret;
+    for (int i = 0; i < 3; i++)
+      ret[i] = linear(val[i]);
+    ret[3] = linear(val[3]) + v[3];
+    return ret;
+  }
+
+  inline Affine3<T> &operator*=(Affine3<T> const &val) {
+    return *this = *this * val;
+  }
+
+  /* Vec3 operands are points: the translation is applied */
+  inline Vec3<T> operator*(Vec3<T> const &val) const {
+    return linear(val) + v[3];
+  }
+
+  inline Vec4<T> operator*(Vec4<T> const &val) const {
+    Vec3<T> ret = linear(Vec3<T>(val.x, val.y, val.z)) + v[3] * val.w;
+    return Vec4<T>(ret.x, ret.y, ret.z, val.w);
+  }
+
+  /* Apply the linear part only, as for a direction */
+  inline Vec3<T> linear(Vec3<T> const &val) const {
+    Vec3<T> ret;
+    for (int j = 0; j < 3; j++)
+      ret[j] = v[0][j] * val[0] + v[1][j] * val[1] + v[2][j] * val[2];
+    return ret;
+  }
+
+  Vec3<T> v[4];
+};
+
+typedef Affine3<float> affine3;
+
+/*
+ * Batch transforms, see the Mat4 versions. The affine transform is
+ * expanded once so that the SIMD mat4 kernels are used for each batch.
+ */
+template <typename T>
+void transform_point(Affine3<T> const &aff, Vec3<T> const *in, Vec3<T> *out,
+                     int count) {
+  transform_point(Mat4<T>(aff), in, out, count);
+}
+
+template <typename T>
+void transform_dir(Affine3<T> const &aff, Vec3<T> const *in, Vec3<T> *out,
+                   int count) {
+  transform_dir(Mat4<T>(aff), in, out, count);
+}
+
+template <typename T>
+void transform(Affine3<T> const &aff, Vec4<T> const *in, Vec4<T> *out,
+               int count) {
+  transform(Mat4<T>(aff), in, out, count);
+}
+
+} /* namespace lol */
+
+#endif // __LOL_AFFINE_H__
@@ -0,0 +1,111 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Aligned types
+// -------------
+// Aligned<V> is V with 16-byte alignment, so that each element of an
+// aligned array can be loaded into one SSE register. avec3 is padded to
+// 16 bytes; the padding is never read as data.
+//
+// The V is a member rather than a base: an avec3 converts to a vec3 where
+// one is taken by value or reference, but an avec3 pointer does not
+// convert to a vec3 pointer, since the strides differ. Components are
+// reached with [] or through value, and the operators are those of V:
+//
+//     out[n] = mat * in[n];
+//     in[n].value.x += 1.0f;
+//     vec4 p = mat4(am) * in[n];
+//
+// AlignedAllocator aligns whole arrays, by default on a cache line.
+//
+
+#if !defined __LOL_ALIGNED_H__
+#define __LOL_ALIGNED_H__
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "lol/matrix.h"
+
+namespace lol {
+
+template <typename V> struct alignas(16) Aligned {
+  inline Aligned() {}
+  inline constexpr Aligned(V const &val) : value(val) {}
+  /* The constructors of V that take several arguments */
+  template <typename... A,
+            typename std::enable_if<(sizeof...(A) > 1), int>::type = 0>
+  inline constexpr Aligned(A const &...args) : value(args...) {}
+
+  inline constexpr operator V const &() const { return value; }
+  inline constexpr operator V &() { return value; }
+
+  inline constexpr auto const &operator[](int n) const { return value[n]; }
+  inline constexpr auto &operator[](int n) { return value[n]; }
+
+  V value;
+};
+
+typedef Aligned<vec3> avec3;
+typedef Aligned<vec4> avec4;
+typedef Aligned<mat4> amat4;
+
+template <typename T, size_t A = (alignof(T) > 64 ? alignof(T) : 64)>
+struct AlignedAllocator {
+  typedef T value_type;
+
+  template <typename U> struct rebind {
+    typedef AlignedAllocator<U, A> other;
+  };
+
+  inline AlignedAllocator() {}
+  template <typename U>
+  inline AlignedAllocator(AlignedAllocator<U, A> const &) {}
+
+  inline T *allocate(size_t count) {
+    return (T *)::operator new(count * sizeof(T), std::align_val_t(A));
+  }
+
+  inline void deallocate(T *p, size_t) {
+    ::operator delete(p, std::align_val_t(A));
+  }
+
+  template <typename U>
+  inline bool operator==(AlignedAllocator<U, A> const &) const {
+    return true;
+  }
+  template <typename U>
+  inline bool operator!=(AlignedAllocator<U, A> const &) const {
+    return false;
+  }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+/*
+ * Batch transforms on aligned arrays, with the same results as the vec4
+ * and vec3 versions in matrix.h. transform_stream() writes out with
+ * non-temporal stores, which is faster when out is too large to stay in
+ * the cache and is not read back right away.
+ */
+void transform(mat4 const &mat, avec4 const *in, avec4 *out, int count);
+void transform_stream(mat4 const &mat, avec4 const *in, avec4 *out,
+                      int count);
+void transform_point(mat4 const &mat, avec3 const *in, avec3 *out,
+                     int count);
+void transform_dir(mat4 const &mat, avec3 const *in, avec3 *out, int count);
+
+} /* namespace lol */
+
+#endif // __LOL_ALIGNED_H__
@@ -0,0 +1,252 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#if defined __unix__ || defined __APPLE__
+#   define USE_MMAP 1
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include <string.h>
+
+#include <new>
+
+#include "lol/arrayfile.h"
+
+using namespace std;
+
+namespace lol
+{
+
+static char const magic[8] = { 'L', 'O', 'L', 'A', 'R', 'R', 'A', 'Y' };
+static uint32_t const version = 1;
+static uint32_t const byte_order = 0x01020304;
+static uint64_t const alignment = 64;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version, byte_order;
+    uint64_t directory, count;
+    uint8_t reserved[32];
+};
+
+static_assert(sizeof(Header) == 64, "array file header must be 64 bytes");
+static_assert(sizeof(details::ArrayEntry) == 24,
+              "array file entries must be 24 bytes");
+
+/*
+ * Reader
+ */
+
+bool ArrayFile::open(char const *path)
+{
+    close();
+
+#if defined USE_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    length = (size_t)st.st_size;
+    void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); /* the mapping keeps the file alive */
+    if (p == MAP_FAILED)
+        return false;
+    base = (uint8_t const *)p;
+#else
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < (long)sizeof(Header))
+    {
+        fclose(f);
+        return false;
+    }
+
+    /* Aligned like the mapping would be, so the arrays stay aligned */
+    uint8_t *p = (uint8_t *)::operator new((size_t)size,
+                                           align_val_t(alignment));
+    length = (size_t)size;
+    base = p;
+    bool ok = fread(p, 1, length, f) == length;
+    fclose(f);
+    if (!ok)
+    {
+        close();
+        return false;
+    }
+#endif
+
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, magic, sizeof(magic))
+         || header.version != version || header.byte_order != byte_order
+         || header.directory > length
+         || header.count > (length - header.directory)
+                              / sizeof(details::ArrayEntry))
+    {
+        close();
+        return false;
+    }
+
+    entries.resize((size_t)header.count);
+    if (header.count)
+        memcpy(&entries[0], base + header.directory,
+               entries.size() * sizeof(details::ArrayEntry));
+
+    /* Every array must be aligned and end before the directory */
+    for (size_t n = 0; n < entries.size(); n++)
+    {
+        details::ArrayEntry const &e = entries[n];
+        if (e.offset % alignment || e.offset > header.directory
+             || !e.elem_size
+             || e.count > (header.directory - e.offset) / e.elem_size)
+        {
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ArrayFile::close()
+{
+    if (base)
+    {
+#if defined USE_MMAP
+        munmap((void *)base, length);
+#else
+        ::operator delete((void *)base, align_val_t(alignment));
+#endif
+    }
+    base = nullptr;
+    length = 0;
+    entries.clear();
+}
+
+/*
+ * Writer
+ */
+
+bool ArrayFileWriter::open(char const *path)
+{
+    close();
+
+    file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    /* A blank header until close() knows where the directory is, so that
+     * an interrupted write leaves a file that open() rejects */
+    Header header;
+    memset(&header, 0, sizeof(header));
+    failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    offset = sizeof(header);
+    in_array = false;
+    entries.clear();
+    return !failed;
+}
+
+void ArrayFileWriter::begin(uint32_t type, uint32_t elem_size)
+{
+    end();
+    pad();
+
+    details::ArrayEntry e;
+    e.type = type;
+    e.elem_size = elem_size;
+    e.offset = offset;
+    e.count = 0;
+    entries.push_back(e);
+    in_array = true;
+}
+
+void ArrayFileWriter::write(uint32_t type, void const *data,
+                            size_t elem_size, size_t count)
+{
+    if (!file || !in_array || entries.back().type != type)
+    {
+        failed = true;
+        return;
+    }
+
+    if (count && fwrite(data, elem_size, count, file) != count)
+        failed = true;
+    entries.back().count += count;
+    offset += (uint64_t)elem_size * count;
+}
+
+void ArrayFileWriter::end()
+{
+    in_array = false;
+}
+
+/* Zeroes up to the next array boundary */
+void ArrayFileWriter::pad()
+{
+    static uint8_t const zeroes[alignment] = { 0 };
+
+    size_t bytes = (size_t)((alignment - offset % alignment) % alignment);
+    if (bytes && file && fwrite(zeroes, 1, bytes, file) != bytes)
+        failed = true;
+    offset += bytes;
+}
+
+bool ArrayFileWriter::close()
+{
+    if (!file)
+        return false;
+
+    end();
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byte_order = byte_order;
+    header.directory = offset;
+    header.count = entries.size();
+
+    if (!entries.empty()
+         && fwrite(&entries[0], sizeof(details::ArrayEntry), entries.size(),
+                   file) != entries.size())
+        failed = true;
+    if (fseek(file, 0, SEEK_SET)
+         || fwrite(&header, sizeof(header), 1, file) != 1)
+        failed = true;
+    if (fclose(file))
+        failed = true;
+
+    file = nullptr;
+    entries.clear();
+    return !failed;
+}
+
+} /* namespace lol */
+
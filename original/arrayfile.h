@@ -0,0 +1,163 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Array files
+// -----------
+// A binary container for arrays of vec2, vec3, vec4 and mat4, stored
+// exactly as they are in memory so that ArrayFile can hand out views
+// straight into the mapped file, with no copying or parsing:
+//
+//     lol::ArrayFileWriter out;
+//     out.open("cache.bin");
+//     out.add(transforms.data(), transforms.size());
+//     out.close();
+//
+//     lol::ArrayFile in;
+//     in.open("cache.bin");
+//     lol::ArrayView<lol::mat4> t = in.get<lol::mat4>(0);
+//
+// Layout, all in the byte order of the machine that wrote the file:
+//
+//     header     64 bytes: "LOLARRAY", version, byte order mark,
+//                directory offset, array count
+//     arrays     each starting on a 64-byte boundary
+//     directory  one entry per array: type, element size, offset, count
+//
+// The directory comes last so that the writer can stream arrays whose
+// size it does not know in advance. Files from a machine of the other
+// byte order are rejected. Where mmap() is not available the reader
+// falls back to reading the whole file into memory.
+//
+
+#if !defined __LOL_ARRAYFILE_H__
+#define __LOL_ARRAYFILE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "lol/matrix.h"
+
+namespace lol {
+
+/* Type tags stored in the directory */
+template <typename T> struct ArrayType;
+template <> struct ArrayType<vec2> { static uint32_t const tag = 1; };
+template <> struct ArrayType<vec3> { static uint32_t const tag = 2; };
+template <> struct ArrayType<vec4> { static uint32_t const tag = 3; };
+template <> struct ArrayType<mat4> { static uint32_t const tag = 4; };
+
+namespace details {
+/* One directory entry, as stored in the file */
+struct ArrayEntry {
+  uint32_t type, elem_size;
+  uint64_t offset, count;
+};
+} /* namespace details */
+
+/* A read-only range of count elements */
+template <typename T> struct ArrayView {
+  inline ArrayView() : data(nullptr), count(0) {}
+  inline ArrayView(T const *_data, size_t _count)
+      : data(_data), count(_count) {}
+
+  inline T const &operator[](size_t n) const { return data[n]; }
+  inline T const *begin() const { return data; }
+  inline T const *end() const { return data + count; }
+  inline size_t size() const { return count; }
+  inline bool empty() const { return !count; }
+
+  T const *data;
+  size_t count;
+};
+
+class ArrayFile {
+public:
+  inline ArrayFile() : base(nullptr), length(0) {}
+  inline ~ArrayFile() { close(); }
+
+  ArrayFile(ArrayFile const &) = delete;
+  ArrayFile &operator=(ArrayFile const &) = delete;
+
+  /* Map the file and check its header and directory. Returns false, with
+   * nothing open, if the file cannot be read or is not a valid array
+   * file. */
+  bool open(char const *path);
+  void close();
+
+  inline int count() const { return (int)entries.size(); }
+  inline uint32_t type(int n) const { return entries[n].type; }
+
+  /* Array n, or an empty view if it does not hold elements of type T.
+   * The view is valid until close(). */
+  template <typename T> inline ArrayView<T> get(int n) const {
+    details::ArrayEntry const &e = entries[n];
+    if (e.type != ArrayType<T>::tag || e.elem_size != sizeof(T))
+      return ArrayView<T>();
+    return ArrayView<T>((T const *)(base + e.offset), (size_t)e.count);
+  }
+
+private:
+  uint8_t const *base;
+  size_t length;
+  std::vector<details::ArrayEntry> entries;
+};
+
+class ArrayFileWriter {
+public:
+  inline ArrayFileWriter()
+      : file(nullptr), offset(0), failed(false), in_array(false) {}
+  inline ~ArrayFileWriter() { close(); }
+
+  ArrayFileWriter(ArrayFileWriter const &) = delete;
+  ArrayFileWriter &operator=(ArrayFileWriter const &) = delete;
+
+  /* Create or truncate the file */
+  bool open(char const *path);
+
+  /* Start a new array of T, ending the current one if any. Elements are
+   * then appended with write() as they become available. */
+  template <typename T> inline void begin() {
+    begin(ArrayType<T>::tag, sizeof(T));
+  }
+  template <typename T> inline void write(T const *data, size_t count) {
+    write(ArrayType<T>::tag, data, sizeof(T), count);
+  }
+  void end();
+
+  /* A whole array at once */
+  template <typename T> inline void add(T const *data, size_t count) {
+    begin<T>();
+    write(data, count);
+    end();
+  }
+
+  /* Write the directory and header. Returns false if any write failed,
+   * or if write() was given a type other than that of begin(). */
+  bool close();
+
+private:
+  void begin(uint32_t type, uint32_t elem_size);
+  void write(uint32_t type, void const *data, size_t elem_size,
+             size_t count);
+  void pad();
+
+  FILE *file;
+  uint64_t offset; /* bytes written so far */
+  bool failed, in_array;
+  std::vector<details::ArrayEntry> entries;
+};
+
+} /* namespace lol */
+
+#endif // __LOL_ARRAYFILE_H__
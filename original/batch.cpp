@@ -0,0 +1,135 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "lol/batch.h"
+
+using namespace std;
+
+namespace lol
+{
+
+/* Items per chunk for bytes of input per item, a multiple of 32 so that
+ * the cull masks of different chunks never share a word */
+static int chunk_size(int bytes)
+{
+    return max(32, (65536 / bytes) & ~31);
+}
+
+void bounds(vec3 const *in, int count, vec3 &min, vec3 &max)
+{
+    float const inf = numeric_limits<float>::infinity();
+    vec3 lo(inf), hi(-inf);
+    for (int n = 0; n < count; n++)
+    {
+        lo.x = std::min(lo.x, in[n].x);
+        lo.y = std::min(lo.y, in[n].y);
+        lo.z = std::min(lo.z, in[n].z);
+        hi.x = std::max(hi.x, in[n].x);
+        hi.y = std::max(hi.y, in[n].y);
+        hi.z = std::max(hi.z, in[n].z);
+    }
+    min = lo;
+    max = hi;
+}
+
+void normalize(vec3 const *in, vec3 *out, int count)
+{
+    for (int n = 0; n < count; n++)
+        out[n] = in[n].normalize();
+}
+
+void transform(ThreadPool &pool, mat4 const &mat, vec4 const *in, vec4 *out,
+               int count)
+{
+    pool.parallel_for(count, chunk_size(sizeof(vec4)), [&](int b, int e)
+    {
+        transform(mat, in + b, out + b, e - b);
+    });
+}
+
+void transform_point(ThreadPool &pool, mat4 const &mat, vec3 const *in,
+                     vec3 *out, int count)
+{
+    pool.parallel_for(count, chunk_size(sizeof(vec3)), [&](int b, int e)
+    {
+        transform_point(mat, in + b, out + b, e - b);
+    });
+}
+
+void transform_dir(ThreadPool &pool, mat4 const &mat, vec3 const *in,
+                   vec3 *out, int count)
+{
+    pool.parallel_for(count, chunk_size(sizeof(vec3)), [&](int b, int e)
+    {
+        transform_dir(mat, in + b, out + b, e - b);
+    });
+}
+
+void normalize(ThreadPool &pool, vec3 const *in, vec3 *out, int count)
+{
+    pool.parallel_for(count, chunk_size(sizeof(vec3)), [&](int b, int e)
+    {
+        normalize(in + b, out + b, e - b);
+    });
+}
+
+/* One partial result per chunk, merged in chunk order */
+void bounds(ThreadPool &pool, vec3 const *in, int count, vec3 &min,
+            vec3 &max)
+{
+    int chunk = chunk_size(sizeof(vec3));
+    if (count <= chunk || pool.count() < 2)
+    {
+        bounds(in, count, min, max);
+        return;
+    }
+
+    vector<vec3> lo((count + chunk - 1) / chunk), hi(lo.size());
+    pool.parallel_for(count, chunk, [&](int b, int e)
+    {
+        bounds(in + b, e - b, lo[b / chunk], hi[b / chunk]);
+    });
+
+    bounds(&lo[0], (int)lo.size(), min, max);
+    vec3 tmp;
+    bounds(&hi[0], (int)hi.size(), tmp, max);
+}
+
+void cull_spheres(ThreadPool &pool, frustum const &f, float const *x,
+                  float const *y, float const *z, float const *radius,
+                  int count, uint32_t *mask)
+{
+    pool.parallel_for(count, chunk_size(4 * sizeof(float)), [&](int b, int e)
+    {
+        cull_spheres(f, x + b, y + b, z + b, radius + b, e - b, mask + b / 32);
+    });
+}
+
+void cull_boxes(ThreadPool &pool, frustum const &f, float const *x,
+                float const *y, float const *z, float const *ex,
+                float const *ey, float const *ez, int count, uint32_t *mask)
+{
+    pool.parallel_for(count, chunk_size(6 * sizeof(float)), [&](int b, int e)
+    {
+        cull_boxes(f, x + b, y + b, z + b, ex + b, ey + b, ez + b, e - b,
+                   mask + b / 32);
+    });
+}
+
+} /* namespace lol */
+
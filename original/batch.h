@@ -0,0 +1,61 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Parallel batch kernels
+// ----------------------
+// Overloads of the batch functions that take a ThreadPool first. Arrays
+// are cut into chunks of about 64 kB of input, sized for the L2 cache,
+// and the chunks are spread over the pool. Arrays of at most one chunk
+// are processed directly on the calling thread. The results are the same
+// as those of the single-threaded versions.
+//
+//     lol::transform(lol::ThreadPool::global(), mat, in, out, count);
+//
+
+#if !defined __LOL_BATCH_H__
+#define __LOL_BATCH_H__
+
+#include <stdint.h>
+
+#include "lol/frustum.h"
+#include "lol/matrix.h"
+#include "lol/threadpool.h"
+
+namespace lol {
+
+/* Smallest and largest coordinates of the points, or +inf and -inf when
+ * count is 0 */
+void bounds(vec3 const *in, int count, vec3 &min, vec3 &max);
+
+/* out[n] = in[n].normalize(); in and out may be the same array */
+void normalize(vec3 const *in, vec3 *out, int count);
+
+void transform(ThreadPool &pool, mat4 const &mat, vec4 const *in, vec4 *out,
+               int count);
+void transform_point(ThreadPool &pool, mat4 const &mat, vec3 const *in,
+                     vec3 *out, int count);
+void transform_dir(ThreadPool &pool, mat4 const &mat, vec3 const *in,
+                   vec3 *out, int count);
+
+void normalize(ThreadPool &pool, vec3 const *in, vec3 *out, int count);
+void bounds(ThreadPool &pool, vec3 const *in, int count, vec3 &min,
+            vec3 &max);
+
+void cull_spheres(ThreadPool &pool, frustum const &f, float const *x,
+                  float const *y, float const *z, float const *radius,
+                  int count, uint32_t *mask);
+void cull_boxes(ThreadPool &pool, frustum const &f, float const *x,
+                float const *y, float const *z, float const *ex,
+                float const *ey, float const *ez, int count, uint32_t *mask);
+
+} /* namespace lol */
+
+#endif // __LOL_BATCH_H__
@@ -0,0 +1,92 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Compile-time math
+// -----------------
+// constexpr versions of the libm functions used by the matrix factories.
+// They compute in double precision and are accurate to a few ulps of
+// double, so once rounded to float they match sinf(), cosf(), tanf() and
+// sqrtf() in all but a handful of cases. They are meant for constant
+// evaluation only; at runtime use the libm functions.
+//
+
+#if !defined __LOL_CTMATH_H__
+#define __LOL_CTMATH_H__
+
+#include <limits>
+#include <type_traits>
+
+/* True while the compiler evaluates a constant expression, so that
+ * constexpr functions can keep a faster runtime path. */
+#if defined __cpp_lib_is_constant_evaluated
+#   define LOL_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif defined __GNUC__ || defined __clang__ || defined _MSC_VER
+#   define LOL_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#   define LOL_CONSTANT_EVALUATED() false
+#endif
+
+namespace lol {
+
+static constexpr double ct_pi = 3.14159265358979323846;
+
+namespace details {
+/* Not constexpr, so that a constant evaluation reaching it fails with
+ * its name in the error */
+inline void ct_sqrt_of_negative_number() {}
+} /* namespace details */
+
+/* NaN for negative x, or a compile error when constant evaluated */
+constexpr double ct_sqrt(double x) {
+  if (x < 0.0 && LOL_CONSTANT_EVALUATED())
+    details::ct_sqrt_of_negative_number();
+  if (!(x > 0.0))
+    return x == 0.0 ? 0.0 : std::numeric_limits<double>::quiet_NaN();
+
+  /* Newton iteration from above converges monotonically */
+  double ret = x > 1.0 ? x : 1.0;
+  for (;;) {
+    double next = 0.5 * (ret + x / ret);
+    if (next >= ret)
+      return ret;
+    ret = next;
+  }
+}
+
+/* Taylor series, only called with |x| <= pi / 2 */
+constexpr double ct_sin_reduced(double x) {
+  double x2 = x * x, term = x, ret = x;
+  for (int n = 1; n < 12; n++) {
+    term *= -x2 / ((2 * n) * (2 * n + 1));
+    ret += term;
+  }
+  return ret;
+}
+
+/* Bring x into [-pi, pi] then fold it into [-pi/2, pi/2] */
+constexpr double ct_sin(double x) {
+  double turns = x / (2.0 * ct_pi);
+  long long k = (long long)(turns < 0.0 ? turns - 0.5 : turns + 0.5);
+  x -= (double)k * 2.0 * ct_pi;
+  if (x > 0.5 * ct_pi)
+    x = ct_pi - x;
+  else if (x < -0.5 * ct_pi)
+    x = -ct_pi - x;
+  return ct_sin_reduced(x);
+}
+
+constexpr double ct_cos(double x) { return ct_sin(x + 0.5 * ct_pi); }
+
+constexpr double ct_tan(double x) { return ct_sin(x) / ct_cos(x); }
+
+} /* namespace lol */
+
+#endif // __LOL_CTMATH_H__
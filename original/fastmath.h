@@ -0,0 +1,107 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Precision policies
+// ------------------
+// Functions that have a cheaper approximate version take a precise or
+// fast tag. The precise versions call libm and are the default wherever
+// the tag is optional. Measured bounds of the fast versions, in float:
+//
+//   rsqrt(x, fast)           relative error < 2.8e-7 with SSE, < 4.8e-6
+//                            without, for normal positive x
+//   sincos(x, s, c, fast)    absolute error < 7.8e-8 for |x| <= 8192
+//   tan(x, fast)             relative error < 4.1e-7 for |x| <= 100
+//                            where |cos x| >= 0.1
+//
+// The fast versions do not handle infinities or NaNs, and rsqrt() does
+// not handle zero or denormals.
+//
+// new/fastmath.h includes this file, so both trees use the same tags
+// and functions.
+//
+
+#if !defined __LOL_FASTMATH_H__
+#define __LOL_FASTMATH_H__
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
+namespace lol {
+
+struct precise_t {};
+struct fast_t {};
+
+inline constexpr precise_t precise{};
+inline constexpr fast_t fast{};
+
+inline float rsqrt(float x, precise_t) { return 1.0f / std::sqrt(x); }
+
+/* Hardware estimate, or the integer trick without SSE, refined by Newton
+ * iterations y' = y (3 - x y^2) / 2 */
+inline float rsqrt(float x, fast_t) {
+#if defined __SSE__
+  float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+  return y * (1.5f - 0.5f * x * y * y);
+#else
+  uint32_t i;
+  std::memcpy(&i, &x, sizeof(i));
+  i = 0x5f375a86 - (i >> 1);
+  float y;
+  std::memcpy(&y, &i, sizeof(y));
+  y = y * (1.5f - 0.5f * x * y * y);
+  return y * (1.5f - 0.5f * x * y * y);
+#endif
+}
+
+inline void sincos(float x, float &s, float &c, precise_t) {
+  s = std::sin(x);
+  c = std::cos(x);
+}
+
+/* Reduction to [-pi/4, pi/4] with pi/2 split in three parts, then minimax
+ * polynomials for both functions; the quadrant selects and signs them */
+inline void sincos(float x, float &s, float &c, fast_t) {
+  float ax = std::fabs(x);
+  int j = (int)(ax * 1.27323954473516f); /* 4 / pi */
+  j = (j + 1) & ~1;
+  float y = (float)j;
+  ax = ((ax - y * 0.78515625f) - y * 2.4187564849853515625e-4f) -
+       y * 3.77489497744594108e-8f;
+
+  float z = ax * ax;
+  float ps = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z -
+              1.6666654611e-1f) * z * ax + ax;
+  float pc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z +
+              4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+
+  int q = j >> 1;
+  float rs = (q & 1) ? pc : ps;
+  float rc = (q & 1) ? ps : pc;
+  s = ((q & 2) != 0) != (x < 0.0f) ? -rs : rs;
+  c = ((q + 1) & 2) ? -rc : rc;
+}
+
+inline float tan(float x, precise_t) { return std::tan(x); }
+
+inline float tan(float x, fast_t) {
+  float s, c;
+  sincos(x, s, c, fast);
+  return s / c;
+}
+
+} /* namespace lol */
+
+#endif // __LOL_FASTMATH_H__
@@ -0,0 +1,182 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#if defined __AVX__
+#   include <immintrin.h>
+#elif defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
+#include "lol/frustum.h"
+
+namespace lol
+{
+
+/*
+ * Eight objects per register with AVX, four with SSE, 32 per mask word.
+ * Each plane is broadcast once; the distances are computed in the same
+ * order as Frustum::distance() and an object is kept unless one of them
+ * is below -radius, so the masks match the scalar tests exactly.
+ */
+#if defined __AVX__
+typedef __m256 cullreg;
+static int const lanes = 8;
+static inline cullreg set1(float x) { return _mm256_set1_ps(x); }
+static inline cullreg load(float const *p) { return _mm256_loadu_ps(p); }
+static inline cullreg add(cullreg a, cullreg b) { return _mm256_add_ps(a, b); }
+static inline cullreg sub(cullreg a, cullreg b) { return _mm256_sub_ps(a, b); }
+static inline cullreg mul(cullreg a, cullreg b) { return _mm256_mul_ps(a, b); }
+static inline cullreg and_(cullreg a, cullreg b) { return _mm256_and_ps(a, b); }
+static inline cullreg not_lt(cullreg a, cullreg b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_NLT_UQ);
+}
+static inline uint32_t movemask(cullreg a)
+{
+    return (uint32_t)_mm256_movemask_ps(a);
+}
+#elif defined __SSE__
+typedef __m128 cullreg;
+static int const lanes = 4;
+static inline cullreg set1(float x) { return _mm_set1_ps(x); }
+static inline cullreg load(float const *p) { return _mm_loadu_ps(p); }
+static inline cullreg add(cullreg a, cullreg b) { return _mm_add_ps(a, b); }
+static inline cullreg sub(cullreg a, cullreg b) { return _mm_sub_ps(a, b); }
+static inline cullreg mul(cullreg a, cullreg b) { return _mm_mul_ps(a, b); }
+static inline cullreg and_(cullreg a, cullreg b) { return _mm_and_ps(a, b); }
+static inline cullreg not_lt(cullreg a, cullreg b)
+{
+    return _mm_cmpnlt_ps(a, b);
+}
+static inline uint32_t movemask(cullreg a)
+{
+    return (uint32_t)_mm_movemask_ps(a);
+}
+#endif
+
+#if defined __SSE__
+struct CullPlanes
+{
+    CullPlanes(frustum const &f)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            a[i] = set1(f.planes[i].x);
+            b[i] = set1(f.planes[i].y);
+            c[i] = set1(f.planes[i].z);
+            d[i] = set1(f.planes[i].w);
+            abs_a[i] = set1(f.planes[i].x < 0.0f ? -f.planes[i].x
+                                                  : f.planes[i].x);
+            abs_b[i] = set1(f.planes[i].y < 0.0f ? -f.planes[i].y
+                                                  : f.planes[i].y);
+            abs_c[i] = set1(f.planes[i].z < 0.0f ? -f.planes[i].z
+                                                  : f.planes[i].z);
+        }
+    }
+
+    inline cullreg distance(int i, cullreg x, cullreg y, cullreg z) const
+    {
+        return add(add(add(mul(a[i], x), mul(b[i], y)), mul(c[i], z)), d[i]);
+    }
+
+    cullreg a[6], b[6], c[6], d[6], abs_a[6], abs_b[6], abs_c[6];
+};
+#endif
+
+template<> void cull_spheres(frustum const &f, float const *x,
+                             float const *y, float const *z,
+                             float const *radius, int count, uint32_t *mask)
+{
+    int n = 0;
+#if defined __SSE__
+    CullPlanes const p(f);
+    cullreg const zero = set1(0.0f);
+
+    for ( ; n + 32 <= count; n += 32)
+    {
+        uint32_t bits = 0;
+        for (int k = 0; k < 32; k += lanes)
+        {
+            cullreg vx = load(x + n + k), vy = load(y + n + k);
+            cullreg vz = load(z + n + k);
+            cullreg neg_r = sub(zero, load(radius + n + k));
+
+            cullreg visible = not_lt(p.distance(0, vx, vy, vz), neg_r);
+            for (int i = 1; i < 6; i++)
+                visible = and_(visible,
+                               not_lt(p.distance(i, vx, vy, vz), neg_r));
+            bits |= movemask(visible) << k;
+        }
+        mask[n / 32] = bits;
+    }
+#endif
+
+    for ( ; n < count; n += 32)
+    {
+        uint32_t bits = 0;
+        for (int k = 0; k < 32 && n + k < count; k++)
+            if (f.sphere_visible(vec3(x[n + k], y[n + k], z[n + k]),
+                                 radius[n + k]))
+                bits |= (uint32_t)1 << k;
+        mask[n / 32] = bits;
+    }
+}
+
+template<> void cull_boxes(frustum const &f, float const *x, float const *y,
+                           float const *z, float const *ex, float const *ey,
+                           float const *ez, int count, uint32_t *mask)
+{
+    int n = 0;
+#if defined __SSE__
+    CullPlanes const p(f);
+    cullreg const zero = set1(0.0f);
+
+    for ( ; n + 32 <= count; n += 32)
+    {
+        uint32_t bits = 0;
+        for (int k = 0; k < 32; k += lanes)
+        {
+            cullreg vx = load(x + n + k), vy = load(y + n + k);
+            cullreg vz = load(z + n + k);
+            cullreg vex = load(ex + n + k), vey = load(ey + n + k);
+            cullreg vez = load(ez + n + k);
+
+            cullreg visible = not_lt(zero, zero);
+            for (int i = 0; i < 6; i++)
+            {
+                cullreg r = add(add(mul(p.abs_a[i], vex),
+                                    mul(p.abs_b[i], vey)),
+                                mul(p.abs_c[i], vez));
+                visible = and_(visible, not_lt(p.distance(i, vx, vy, vz),
+                                               sub(zero, r)));
+            }
+            bits |= movemask(visible) << k;
+        }
+        mask[n / 32] = bits;
+    }
+#endif
+
+    for ( ; n < count; n += 32)
+    {
+        uint32_t bits = 0;
+        for (int k = 0; k < 32 && n + k < count; k++)
+            if (f.box_visible(vec3(x[n + k], y[n + k], z[n + k]),
+                              vec3(ex[n + k], ey[n + k], ez[n + k])))
+                bits |= (uint32_t)1 << k;
+        mask[n / 32] = bits;
+    }
+}
+
+} /* namespace lol */
+
@@ -0,0 +1,173 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The Frustum class
+// -----------------
+// The six clipping planes of a view-projection matrix, such as the ones
+// built by Mat4::frustum() or Mat4::perspective() times a view matrix.
+// Each plane is stored as (a, b, c, d) with a unit normal pointing inside,
+// so that a x + b y + c z + d is the signed distance of (x, y, z).
+//
+// The tests are conservative: objects that straddle two planes outside
+// a corner of the frustum are reported visible.
+//
+
+#if !defined __LOL_FRUSTUM_H__
+#define __LOL_FRUSTUM_H__
+
+#include <stdint.h>
+
+#include "lol/matrix.h"
+
+namespace lol {
+
+template <typename T> struct Frustum {
+  enum { Left, Right, Bottom, Top, Near, Far };
+
+  inline Frustum() {}
+
+  /* Gribb-Hartmann extraction: the clip space test -w <= x <= w becomes
+   * the planes row3 + row0 and row3 - row0, and so on for y and z */
+  explicit inline constexpr Frustum(Mat4<T> const &m)
+      : planes{plane(m, 0, 1), plane(m, 0, -1), plane(m, 1, 1),
+               plane(m, 1, -1), plane(m, 2, 1), plane(m, 2, -1)} {}
+
+  inline constexpr bool sphere_visible(Vec3<T> const &center, T radius) const {
+    for (int i = 0; i < 6; i++)
+      if (distance(i, center) < -radius)
+        return false;
+    return true;
+  }
+
+  /* Axis-aligned box given by its center and half extents */
+  inline constexpr bool box_visible(Vec3<T> const &center,
+                                    Vec3<T> const &extent) const {
+    for (int i = 0; i < 6; i++) {
+      T r = abs(planes[i].x) * extent.x + abs(planes[i].y) * extent.y +
+            abs(planes[i].z) * extent.z;
+      if (distance(i, center) < -r)
+        return false;
+    }
+    return true;
+  }
+
+  inline constexpr T distance(int i, Vec3<T> const &p) const {
+    return planes[i].x * p.x + planes[i].y * p.y + planes[i].z * p.z +
+           planes[i].w;
+  }
+
+  Vec4<T> planes[6];
+
+private:
+  static constexpr Vec4<T> plane(Mat4<T> const &m, int row, int sign) {
+    Vec4<T> p(m[0][3] + (T)sign * m[0][row], m[1][3] + (T)sign * m[1][row],
+              m[2][3] + (T)sign * m[2][row], m[3][3] + (T)sign * m[3][row]);
+    T inv = details::inv_sqrt(p.x * p.x + p.y * p.y + p.z * p.z, precise);
+    return Vec4<T>(p.x * inv, p.y * inv, p.z * inv, p.w * inv);
+  }
+
+  static constexpr T abs(T x) { return x < (T)0 ? -x : x; }
+};
+
+typedef Frustum<float> frustum;
+
+/*
+ * Batch culling of objects stored as separate coordinate arrays. The mask
+ * versions set bit n % 32 of mask[n / 32] when object n is visible and
+ * write (count + 31) / 32 words. The index versions write the indices of
+ * the visible objects in increasing order and return how many there are.
+ */
+template <typename T>
+void cull_spheres(Frustum<T> const &f, T const *x, T const *y, T const *z,
+                  T const *radius, int count, uint32_t *mask) {
+  for (int n = 0; n < count; n += 32) {
+    uint32_t bits = 0;
+    for (int k = 0; k < 32 && n + k < count; k++)
+      if (f.sphere_visible(Vec3<T>(x[n + k], y[n + k], z[n + k]),
+                           radius[n + k]))
+        bits |= (uint32_t)1 << k;
+    mask[n / 32] = bits;
+  }
+}
+
+template <typename T>
+void cull_boxes(Frustum<T> const &f, T const *x, T const *y, T const *z,
+                T const *ex, T const *ey, T const *ez, int count,
+                uint32_t *mask) {
+  for (int n = 0; n < count; n += 32) {
+    uint32_t bits = 0;
+    for (int k = 0; k < 32 && n + k < count; k++)
+      if (f.box_visible(Vec3<T>(x[n + k], y[n + k], z[n + k]),
+                        Vec3<T>(ex[n + k], ey[n + k], ez[n + k])))
+        bits |= (uint32_t)1 << k;
+    mask[n / 32] = bits;
+  }
+}
+
+template <>
+void cull_spheres(frustum const &f, float const *x, float const *y,
+                  float const *z, float const *radius, int count,
+                  uint32_t *mask);
+template <>
+void cull_boxes(frustum const &f, float const *x, float const *y,
+                float const *z, float const *ex, float const *ey,
+                float const *ez, int count, uint32_t *mask);
+
+namespace details {
+/* Runs of the mask kernel small enough for the bits to stay in L1 */
+static int const cull_chunk = 1024;
+
+inline int mask_to_indices(uint32_t const *mask, int base, int count,
+                           int *indices) {
+  int ret = 0;
+  for (int w = 0; w < (count + 31) / 32; w++)
+    for (uint32_t bits = mask[w]; bits; bits &= bits - 1) {
+      int k = 0;
+      while (!(bits >> k & 1))
+        k++;
+      indices[ret++] = base + w * 32 + k;
+    }
+  return ret;
+}
+} /* namespace details */
+
+template <typename T>
+int cull_spheres(Frustum<T> const &f, T const *x, T const *y, T const *z,
+                 T const *radius, int count, int *indices) {
+  uint32_t mask[details::cull_chunk / 32];
+  int ret = 0;
+  for (int n = 0; n < count; n += details::cull_chunk) {
+    int size = count - n < details::cull_chunk ? count - n
+                                               : details::cull_chunk;
+    cull_spheres(f, x + n, y + n, z + n, radius + n, size, mask);
+    ret += details::mask_to_indices(mask, n, size, indices + ret);
+  }
+  return ret;
+}
+
+template <typename T>
+int cull_boxes(Frustum<T> const &f, T const *x, T const *y, T const *z,
+               T const *ex, T const *ey, T const *ez, int count,
+               int *indices) {
+  uint32_t mask[details::cull_chunk / 32];
+  int ret = 0;
+  for (int n = 0; n < count; n += details::cull_chunk) {
+    int size = count - n < details::cull_chunk ? count - n
+                                               : details::cull_chunk;
+    cull_boxes(f, x + n, y + n, z + n, ex + n, ey + n, ez + n, size, mask);
+    ret += details::mask_to_indices(mask, n, size, indices + ret);
+  }
+  return ret;
+}
+
+} /* namespace lol */
+
+#endif // __LOL_FRUSTUM_H__
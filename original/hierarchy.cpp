@@ -0,0 +1,169 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <algorithm>
+#include <climits>
+
+#include "lol/hierarchy.h"
+#include "lol/threadpool.h"
+
+using namespace std;
+
+namespace lol
+{
+
+template<typename T>
+static void permute(vector<T> &data, vector<int> const &new_slot)
+{
+    vector<T> tmp(data.size());
+    for (size_t s = 0; s < data.size(); s++)
+        tmp[new_slot[s]] = data[s];
+    data.swap(tmp);
+}
+
+Hierarchy::Hierarchy()
+  : layout_dirty(false),
+    first_dirty_depth(INT_MAX),
+    max_threads(0)
+{
+}
+
+int Hierarchy::add(int parent, mat4 const &local)
+{
+    int node = count();
+    int slot = (int)locals.size();
+    int parent_slot = parent < 0 ? -1 : slot_of[parent];
+    int depth = parent < 0 ? 0 : depths[parent_slot] + 1;
+
+    /* Appending keeps parents before children, but breadth-first order
+     * and the level table are only restored by the next update() */
+    locals.push_back(local);
+    worlds.push_back(local);
+    parents.push_back(parent_slot);
+    depths.push_back(depth);
+    handle_of.push_back(node);
+    dirty_flags.push_back(1);
+    changed_flags.push_back(0);
+    slot_of.push_back(slot);
+    parent_of.push_back(parent);
+
+    layout_dirty = true;
+    first_dirty_depth = min(first_dirty_depth, depth);
+    return node;
+}
+
+void Hierarchy::set_local(int node, mat4 const &local)
+{
+    int slot = slot_of[node];
+    locals[slot] = local;
+    dirty_flags[slot] = 1;
+    first_dirty_depth = min(first_dirty_depth, depths[slot]);
+}
+
+/* Stable counting sort of the slots by depth */
+void Hierarchy::relayout()
+{
+    int n = (int)locals.size();
+    int levels = n ? *max_element(depths.begin(), depths.end()) + 1 : 0;
+
+    level_start.assign(levels + 1, 0);
+    for (int s = 0; s < n; s++)
+        level_start[depths[s] + 1]++;
+    for (int d = 0; d < levels; d++)
+        level_start[d + 1] += level_start[d];
+
+    vector<int> next(level_start.begin(), level_start.end() - 1);
+    vector<int> new_slot(n);
+    for (int s = 0; s < n; s++)
+        new_slot[s] = next[depths[s]]++;
+
+    for (int s = 0; s < n; s++)
+        if (parents[s] >= 0)
+            parents[s] = new_slot[parents[s]];
+
+    permute(locals, new_slot);
+    permute(worlds, new_slot);
+    permute(parents, new_slot);
+    permute(depths, new_slot);
+    permute(handle_of, new_slot);
+    permute(dirty_flags, new_slot);
+    permute(changed_flags, new_slot);
+
+    for (int s = 0; s < n; s++)
+        slot_of[handle_of[s]] = s;
+
+    layout_dirty = false;
+}
+
+/* A node is recomputed when its local matrix changed or its parent was
+ * recomputed; parents are always in an earlier, completed level */
+void Hierarchy::update_range(int begin, int end)
+{
+    for (int s = begin; s < end; s++)
+    {
+        int p = parents[s];
+        unsigned char changed = dirty_flags[s] | (p >= 0 ? changed_flags[p] : 0);
+        changed_flags[s] = changed;
+        if (changed)
+        {
+            worlds[s] = p >= 0 ? worlds[p] * locals[s] : locals[s];
+            dirty_flags[s] = 0;
+        }
+    }
+}
+
+void Hierarchy::update()
+{
+    if (layout_dirty)
+        relayout();
+    if (locals.empty())
+        return;
+
+    int levels = (int)level_start.size() - 1;
+    int first = min(first_dirty_depth, levels);
+    first_dirty_depth = INT_MAX;
+
+    /* Nothing above the first dirty level can have changed */
+    fill(changed_flags.begin(), changed_flags.begin() + level_start[first], 0);
+    if (first >= levels)
+        return;
+
+    /* The shared pool has one thread per hardware thread; levels are cut
+     * into at most threads chunks so that no more of them take part */
+    ThreadPool &pool = ThreadPool::global();
+    int threads = max_threads > 0 ? min(max_threads, pool.count())
+                                  : pool.count();
+
+    /* Narrow levels are updated on the calling thread, each wide level is
+     * one pool job that returns once the whole level is done */
+    for (int d = first; d < levels; d++)
+    {
+        int begin = level_start[d], end = level_start[d + 1];
+        int size = end - begin;
+        if (threads <= 1 || size < parallel_threshold)
+        {
+            update_range(begin, end);
+            continue;
+        }
+
+        int chunk = (size + threads - 1) / threads;
+        pool.parallel_for(size, chunk, [&](int b, int e)
+        {
+            update_range(begin + b, begin + e);
+        });
+    }
+}
+
+} /* namespace lol */
+
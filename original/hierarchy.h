@@ -0,0 +1,87 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The Hierarchy class
+// -------------------
+// A tree of transforms where the world matrix of each node is the world
+// matrix of its parent times its local matrix. Nodes are kept in
+// breadth-first order in flat arrays. update() only recomputes nodes whose
+// local matrix changed and their descendants, one depth level at a time;
+// large levels are split across threads.
+//
+// Nodes are identified by the handle returned by add(), which stays valid
+// when the arrays are reordered. world() and changed() reflect the last
+// call to update().
+//
+
+#if !defined __LOL_HIERARCHY_H__
+#define __LOL_HIERARCHY_H__
+
+#include <vector>
+
+#include "lol/matrix.h"
+
+namespace lol {
+
+class Hierarchy {
+public:
+  Hierarchy();
+
+  /* Add a node below parent, or a root if parent is -1, and return its
+   * handle. The parent must already exist. */
+  int add(int parent, mat4 const &local);
+
+  inline int count() const { return (int)slot_of.size(); }
+  inline int parent(int node) const { return parent_of[node]; }
+
+  inline mat4 const &local(int node) const { return locals[slot_of[node]]; }
+  void set_local(int node, mat4 const &local);
+
+  inline mat4 const &world(int node) const { return worlds[slot_of[node]]; }
+  /* Whether the world matrix was recomputed by the last update() */
+  inline bool changed(int node) const {
+    return changed_flags[slot_of[node]] != 0;
+  }
+
+  /* Recompute the world matrices of dirty nodes and their descendants */
+  void update();
+
+  /* Upper bound on threads per level, 0 for every thread of
+   * ThreadPool::global(). Levels of at least parallel_threshold nodes are
+   * run as jobs on that shared pool; no threads are started by update(). */
+  inline void set_max_threads(int count) { max_threads = count; }
+
+  /* Levels with fewer nodes than this are updated on one thread */
+  static int const parallel_threshold = 4096;
+
+private:
+  void relayout();
+  void update_range(int begin, int end);
+
+  /* Per slot, in breadth-first order */
+  std::vector<mat4> locals, worlds;
+  std::vector<int> parents, depths, handle_of;
+  std::vector<unsigned char> dirty_flags, changed_flags;
+
+  /* Per handle */
+  std::vector<int> slot_of, parent_of;
+
+  /* Slots [level_start[d], level_start[d + 1]) hold the nodes of depth d */
+  std::vector<int> level_start;
+
+  bool layout_dirty;
+  int first_dirty_depth;
+  int max_threads;
+};
+
+} /* namespace lol */
+
+#endif // __LOL_HIERARCHY_H__
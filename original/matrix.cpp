@@ -12,160 +12,444 @@
 #   include "config.h"
 #endif
 
+#include <cstdio> /* printf() */
 #include <cstdlib> /* free() */
 #include <cstring> /* strdup() */
 
+#if defined __AVX__
+#   include <immintrin.h>
+#elif defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
 #include "lol/matrix.h"
+#include "lol/aligned.h"
 
 using namespace std;
 
 namespace lol
 {
 
-static inline float det3(float a, float b, float c,
-                         float d, float e, float f,
-                         float g, float h, float i)
-{
-    return a * (e * i - h * f)
-         + b * (f * g - i * d)
-         + c * (d * h - g * e);
-}
+/*
+ * Inversion by Laplace expansion. The 2x2 minors from mat4::minors() are
+ * computed once and shared by the determinant and all 16 cofactors. The
+ * formula is symmetric under transposition, so it is applied directly to
+ * the column-major storage.
+ */
 
-static inline float cofact3(mat4 const &mat, int i, int j)
+#if defined __SSE__
+/* Same expansion, one row of the result per register:
+ *  - t[k] holds (m[1][k], m[0][k], m[3][k], m[2][k])
+ *  - p[k] holds (c[k], c[k], s[k], s[k])
+ * and the alternating cofactor signs are applied last. */
+static inline float try_invert_sse(mat4 const &m, mat4 &ret)
 {
-    return det3(mat[(i + 1) & 3][(j + 1) & 3],
-                mat[(i + 2) & 3][(j + 1) & 3],
-                mat[(i + 3) & 3][(j + 1) & 3],
-                mat[(i + 1) & 3][(j + 2) & 3],
-                mat[(i + 2) & 3][(j + 2) & 3],
-                mat[(i + 3) & 3][(j + 2) & 3],
-                mat[(i + 1) & 3][(j + 3) & 3],
-                mat[(i + 2) & 3][(j + 3) & 3],
-                mat[(i + 3) & 3][(j + 3) & 3]) * (((i + j) & 1) ? -1.0f : 1.0f);
+    __m128 r0 = _mm_loadu_ps(&m[0][0]);
+    __m128 r1 = _mm_loadu_ps(&m[1][0]);
+    __m128 r2 = _mm_loadu_ps(&m[2][0]);
+    __m128 r3 = _mm_loadu_ps(&m[3][0]);
+
+#define SHUF(v, a, b, c, d) _mm_shuffle_ps(v, v, _MM_SHUFFLE(d, c, b, a))
+    /* s0..s3, s4 s5 x x, c0..c3, c4 c5 x x */
+    __m128 s03 = _mm_sub_ps(_mm_mul_ps(SHUF(r0, 0, 0, 0, 1), SHUF(r1, 1, 2, 3, 2)),
+                            _mm_mul_ps(SHUF(r1, 0, 0, 0, 1), SHUF(r0, 1, 2, 3, 2)));
+    __m128 s45 = _mm_sub_ps(_mm_mul_ps(SHUF(r0, 1, 2, 1, 2), SHUF(r1, 3, 3, 3, 3)),
+                            _mm_mul_ps(SHUF(r1, 1, 2, 1, 2), SHUF(r0, 3, 3, 3, 3)));
+    __m128 c03 = _mm_sub_ps(_mm_mul_ps(SHUF(r2, 0, 0, 0, 1), SHUF(r3, 1, 2, 3, 2)),
+                            _mm_mul_ps(SHUF(r3, 0, 0, 0, 1), SHUF(r2, 1, 2, 3, 2)));
+    __m128 c45 = _mm_sub_ps(_mm_mul_ps(SHUF(r2, 1, 2, 1, 2), SHUF(r3, 3, 3, 3, 3)),
+                            _mm_mul_ps(SHUF(r3, 1, 2, 1, 2), SHUF(r2, 3, 3, 3, 3)));
+#undef SHUF
+
+    __m128 p0 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 p1 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 p2 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 p3 = _mm_shuffle_ps(c03, s03, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 p4 = _mm_shuffle_ps(c45, s45, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 p5 = _mm_shuffle_ps(c45, s45, _MM_SHUFFLE(1, 1, 1, 1));
+
+    __m128 t0 = r1, t1 = r0, t2 = r3, t3 = r2;
+    _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+
+    __m128 sign = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    __m128 i0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(t1, p5), _mm_mul_ps(t2, p4)),
+                           _mm_mul_ps(t3, p3));
+    __m128 i1 = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(t2, p2), _mm_mul_ps(t0, p5)),
+                           _mm_mul_ps(t3, p1));
+    __m128 i2 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(t0, p4), _mm_mul_ps(t1, p2)),
+                           _mm_mul_ps(t3, p0));
+    __m128 i3 = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(t1, p1), _mm_mul_ps(t0, p3)),
+                           _mm_mul_ps(t2, p0));
+    i0 = _mm_mul_ps(i0, sign);
+    i1 = _mm_mul_ps(i1, sign);
+    i2 = _mm_mul_ps(i2, sign);
+    i3 = _mm_mul_ps(i3, sign);
+
+    /* Expand along the first row: det = sum of m[0][k] * cofactor */
+    __m128 col0 = _mm_movelh_ps(_mm_unpacklo_ps(i0, i1), _mm_unpacklo_ps(i2, i3));
+    __m128 dot = _mm_mul_ps(r0, col0);
+    dot = _mm_add_ps(dot, _mm_movehl_ps(dot, dot));
+    dot = _mm_add_ss(dot, _mm_shuffle_ps(dot, dot, 0x55));
+    float d = _mm_cvtss_f32(dot);
+
+    if (d)
+    {
+        __m128 invdet = _mm_set1_ps(1.0f / d);
+        _mm_storeu_ps(&ret[0][0], _mm_mul_ps(i0, invdet));
+        _mm_storeu_ps(&ret[1][0], _mm_mul_ps(i1, invdet));
+        _mm_storeu_ps(&ret[2][0], _mm_mul_ps(i2, invdet));
+        _mm_storeu_ps(&ret[3][0], _mm_mul_ps(i3, invdet));
+    }
+    return d;
 }
+#endif
 
-template<> float mat4::det() const
+template<> float mat4::try_invert(mat4 &ret) const
 {
-    float ret = 0;
-    for (int n = 0; n < 4; n++)
-        ret += (*this)[n][0] * cofact3(*this, n, 0);
-    return ret;
+    LOL_STATS_SCOPE(Mat4Invert);
+
+#if defined __SSE__
+    return try_invert_sse(*this, ret);
+#else
+    mat4 const &m = *this;
+    float s[6], c[6];
+    mat4::minors(m, s, c);
+
+    float d = mat4::det_minors(s, c);
+    if (!d)
+        return d;
+
+    float invdet = 1.0f / d;
+    mat4 inv;
+    inv[0][0] = ( m[1][1] * c[5] - m[1][2] * c[4] + m[1][3] * c[3]) * invdet;
+    inv[0][1] = (-m[0][1] * c[5] + m[0][2] * c[4] - m[0][3] * c[3]) * invdet;
+    inv[0][2] = ( m[3][1] * s[5] - m[3][2] * s[4] + m[3][3] * s[3]) * invdet;
+    inv[0][3] = (-m[2][1] * s[5] + m[2][2] * s[4] - m[2][3] * s[3]) * invdet;
+
+    inv[1][0] = (-m[1][0] * c[5] + m[1][2] * c[2] - m[1][3] * c[1]) * invdet;
+    inv[1][1] = ( m[0][0] * c[5] - m[0][2] * c[2] + m[0][3] * c[1]) * invdet;
+    inv[1][2] = (-m[3][0] * s[5] + m[3][2] * s[2] - m[3][3] * s[1]) * invdet;
+    inv[1][3] = ( m[2][0] * s[5] - m[2][2] * s[2] + m[2][3] * s[1]) * invdet;
+
+    inv[2][0] = ( m[1][0] * c[4] - m[1][1] * c[2] + m[1][3] * c[0]) * invdet;
+    inv[2][1] = (-m[0][0] * c[4] + m[0][1] * c[2] - m[0][3] * c[0]) * invdet;
+    inv[2][2] = ( m[3][0] * s[4] - m[3][1] * s[2] + m[3][3] * s[0]) * invdet;
+    inv[2][3] = (-m[2][0] * s[4] + m[2][1] * s[2] - m[2][3] * s[0]) * invdet;
+
+    inv[3][0] = (-m[1][0] * c[3] + m[1][1] * c[1] - m[1][2] * c[0]) * invdet;
+    inv[3][1] = ( m[0][0] * c[3] - m[0][1] * c[1] + m[0][2] * c[0]) * invdet;
+    inv[3][2] = (-m[3][0] * s[3] + m[3][1] * s[1] - m[3][2] * s[0]) * invdet;
+    inv[3][3] = ( m[2][0] * s[3] - m[2][1] * s[1] + m[2][2] * s[0]) * invdet;
+
+    ret = inv;
+    return d;
+#endif
 }
 
 template<> mat4 mat4::invert() const
 {
     mat4 ret;
-    float d = det();
-    if (d)
-    {
-        d = 1.0f / d;
-        for (int j = 0; j < 4; j++)
-            for (int i = 0; i < 4; i++)
-                ret[j][i] = cofact3(*this, i, j) * d;
-    }
+    try_invert(ret);
     return ret;
 }
 
 template<> void mat4::printf() const
 {
-#if 0
     mat4 const &p = *this;
 
-    Log::Debug("[ %6.6f %6.6f %6.6f %6.6f\n",
-               p[0][0], p[1][0], p[2][0], p[3][0]);
-    Log::Debug("  %6.6f %6.6f %6.6f %6.6f\n",
-               p[0][1], p[1][1], p[2][1], p[3][1]);
-    Log::Debug("  %6.6f %6.6f %6.6f %6.6f\n",
-               p[0][2], p[1][2], p[2][2], p[3][2]);
-    Log::Debug("  %6.6f %6.6f %6.6f %6.6f ]\n",
-               p[0][3], p[1][3], p[2][3], p[3][3]);
+    ::printf("[ %6.6f %6.6f %6.6f %6.6f\n",
+             p[0][0], p[1][0], p[2][0], p[3][0]);
+    ::printf("  %6.6f %6.6f %6.6f %6.6f\n",
+             p[0][1], p[1][1], p[2][1], p[3][1]);
+    ::printf("  %6.6f %6.6f %6.6f %6.6f\n",
+             p[0][2], p[1][2], p[2][2], p[3][2]);
+    ::printf("  %6.6f %6.6f %6.6f %6.6f ]\n",
+             p[0][3], p[1][3], p[2][3], p[3][3]);
+}
+
+/*
+ * SIMD kernels. The matrix columns are kept in registers and each vector
+ * component is broadcast against its column, accumulating in the same
+ * order as Mat4::operator*(Vec4) so that results match the scalar operator
+ * up to FMA contraction.
+ */
+
+#if defined __AVX__
+/* Two vec4 per register; col holds each column in both halves */
+static inline __m256 mul_avx(__m256 const *col, __m256 v)
+{
+    __m256 ret = _mm256_mul_ps(col[0], _mm256_permute_ps(v, 0x00));
+    ret = _mm256_add_ps(ret, _mm256_mul_ps(col[1], _mm256_permute_ps(v, 0x55)));
+    ret = _mm256_add_ps(ret, _mm256_mul_ps(col[2], _mm256_permute_ps(v, 0xaa)));
+    return _mm256_add_ps(ret, _mm256_mul_ps(col[3], _mm256_permute_ps(v, 0xff)));
+}
 #endif
+
+#if defined __SSE__
+static inline __m128 mul_sse(__m128 const *col, __m128 v)
+{
+    __m128 ret = _mm_mul_ps(col[0], _mm_shuffle_ps(v, v, 0x00));
+    ret = _mm_add_ps(ret, _mm_mul_ps(col[1], _mm_shuffle_ps(v, v, 0x55)));
+    ret = _mm_add_ps(ret, _mm_mul_ps(col[2], _mm_shuffle_ps(v, v, 0xaa)));
+    return _mm_add_ps(ret, _mm_mul_ps(col[3], _mm_shuffle_ps(v, v, 0xff)));
 }
 
-template<> mat4 mat4::ortho(float left, float right, float bottom,
-                            float top, float near, float far)
+/* Same for a vec3 in the first three lanes of v, ignoring the fourth */
+static inline __m128 mul3_sse(__m128 const *col, __m128 v, bool point)
 {
-    float invrl = (right != left) ? 1.0f / (right - left) : 0.0f;
-    float invtb = (top != bottom) ? 1.0f / (top - bottom) : 0.0f;
-    float invfn = (far != near) ? 1.0f / (far - near) : 0.0f;
+    __m128 ret = _mm_mul_ps(col[0], _mm_shuffle_ps(v, v, 0x00));
+    ret = _mm_add_ps(ret, _mm_mul_ps(col[1], _mm_shuffle_ps(v, v, 0x55)));
+    ret = _mm_add_ps(ret, _mm_mul_ps(col[2], _mm_shuffle_ps(v, v, 0xaa)));
+    return point ? _mm_add_ps(ret, col[3]) : ret;
+}
 
-    mat4 ret(0.0f);
-    ret[0][0] = 2.0f * invrl;
-    ret[1][1] = 2.0f * invtb;
-    ret[2][2] = -2.0f * invfn;
-    ret[3][0] = - (right + left) * invrl;
-    ret[3][1] = - (top + bottom) * invtb;
-    ret[3][2] = - (far + near) * invfn;
-    ret[3][3] = 1.0f;
-    return ret;
+/* Four packed vec3 (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) to and from
+ * xxxx yyyy zzzz */
+static inline void load3_sse(float const *p, __m128 &x, __m128 &y, __m128 &z)
+{
+    __m128 a = _mm_loadu_ps(p);
+    __m128 b = _mm_loadu_ps(p + 4);
+    __m128 c = _mm_loadu_ps(p + 8);
+    __m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+    __m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+    x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(t1, c, _MM_SHUFFLE(3, 0, 3, 1));
 }
 
-template<> mat4 mat4::frustum(float left, float right, float bottom,
-                              float top, float near, float far)
+static inline void store3_sse(float *p, __m128 x, __m128 y, __m128 z)
 {
-    float invrl = (right != left) ? 1.0f / (right - left) : 0.0f;
-    float invtb = (top != bottom) ? 1.0f / (top - bottom) : 0.0f;
-    float invfn = (far != near) ? 1.0f / (far - near) : 0.0f;
+    __m128 xy0 = _mm_unpacklo_ps(x, y), xy1 = _mm_unpackhi_ps(x, y);
+    __m128 yz0 = _mm_unpacklo_ps(y, z), yz1 = _mm_unpackhi_ps(y, z);
+    __m128 zx0 = _mm_unpacklo_ps(z, x), zx1 = _mm_unpackhi_ps(z, x);
+    _mm_storeu_ps(p, _mm_shuffle_ps(xy0, zx0, _MM_SHUFFLE(3, 0, 1, 0)));
+    _mm_storeu_ps(p + 4, _mm_shuffle_ps(yz0, xy1, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_storeu_ps(p + 8, _mm_shuffle_ps(zx1, yz1, _MM_SHUFFLE(3, 2, 3, 0)));
+}
 
-    mat4 ret(0.0f);
-    ret[0][0] = 2.0f * near * invrl;
-    ret[1][1] = 2.0f * near * invtb;
-    ret[2][0] = (right + left) * invrl;
-    ret[2][1] = (top + bottom) * invtb;
-    ret[2][2] = - (far + near) * invfn;
-    ret[2][3] = -1.0f;
-    ret[3][2] = -2.0f * far * near * invfn;
-    return ret;
+/* Transform four vec3 at once; w is 1 for points and 0 for directions */
+static inline void transform3_sse(mat4 const &mat, vec3 const *in, vec3 *out,
+                                  int count, bool point)
+{
+    __m128 m[4][3];
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 3; j++)
+            m[i][j] = _mm_set1_ps(mat[i][j]);
+
+    int n = 0;
+    for ( ; n + 4 <= count; n += 4)
+    {
+        __m128 x, y, z, ret[3];
+        load3_sse(&in[n][0], x, y, z);
+        for (int j = 0; j < 3; j++)
+        {
+            ret[j] = _mm_mul_ps(m[0][j], x);
+            ret[j] = _mm_add_ps(ret[j], _mm_mul_ps(m[1][j], y));
+            ret[j] = _mm_add_ps(ret[j], _mm_mul_ps(m[2][j], z));
+            if (point)
+                ret[j] = _mm_add_ps(ret[j], m[3][j]);
+        }
+        store3_sse(&out[n][0], ret[0], ret[1], ret[2]);
+    }
+
+    for ( ; n < count; n++)
+        out[n] = mat * vec4(in[n].x, in[n].y, in[n].z, point ? 1.0f : 0.0f);
 }
+#endif
 
-template<> mat4 mat4::perspective(float theta, float width,
-                                  float height, float near, float far)
+/*
+ * Matrix product. Column i of a * b is a applied to column i of b; both
+ * operands are loaded into registers before anything is stored, so ret
+ * may alias either of them.
+ */
+void details::mul_mat4(mat4 &ret, mat4 const &a, mat4 const &b)
 {
-    float t1 = tanf(theta / 2.0f);
-    float t2 = t1 * height / width;
+    LOL_STATS_SCOPE(Mat4Mul);
 
-    return frustum(-near * t1, near * t1, -near * t2, near * t2, near, far);
+#if defined __AVX__
+    __m256 col[4];
+    for (int i = 0; i < 4; i++)
+        col[i] = _mm256_broadcast_ps((__m128 const *)&a[i][0]);
+    __m256 v0 = _mm256_loadu_ps(&b[0][0]);
+    __m256 v1 = _mm256_loadu_ps(&b[2][0]);
+    _mm256_storeu_ps(&ret[0][0], mul_avx(col, v0));
+    _mm256_storeu_ps(&ret[2][0], mul_avx(col, v1));
+#elif defined __SSE__
+    __m128 col[4], v[4];
+    for (int i = 0; i < 4; i++)
+    {
+        col[i] = _mm_loadu_ps(&a[i][0]);
+        v[i] = _mm_loadu_ps(&b[i][0]);
+    }
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_ps(&ret[i][0], mul_sse(col, v[i]));
+#else
+    mat4 tmp;
+    for (int i = 0; i < 4; i++)
+        tmp[i] = a * b[i];
+    ret = tmp;
+#endif
 }
 
-template<> mat4 mat4::translate(float x, float y, float z)
+template<> void transform(mat4 const &mat, vec4 const *in, vec4 *out,
+                          int count)
 {
-    mat4 ret(1.0f);
-    ret[3][0] = x;
-    ret[3][1] = y;
-    ret[3][2] = z;
-    return ret;
+    int n = 0;
+#if defined __AVX__
+    __m256 col[4];
+    for (int i = 0; i < 4; i++)
+        col[i] = _mm256_broadcast_ps((__m128 const *)&mat[i][0]);
+
+    /* Two vectors per register, four per iteration */
+    for ( ; n + 4 <= count; n += 4)
+    {
+        __m256 v0 = _mm256_loadu_ps(&in[n][0]);
+        __m256 v1 = _mm256_loadu_ps(&in[n + 2][0]);
+        _mm256_storeu_ps(&out[n][0], mul_avx(col, v0));
+        _mm256_storeu_ps(&out[n + 2][0], mul_avx(col, v1));
+    }
+#endif
+#if defined __SSE__
+    __m128 col4[4];
+    for (int i = 0; i < 4; i++)
+        col4[i] = _mm_loadu_ps(&mat[i][0]);
+
+    for ( ; n < count; n++)
+        _mm_storeu_ps(&out[n][0], mul_sse(col4, _mm_loadu_ps(&in[n][0])));
+#else
+    for ( ; n < count; n++)
+        out[n] = mat * in[n];
+#endif
 }
 
-template<> mat4 mat4::rotate(float theta, float x, float y, float z)
+template<> void transform_point(mat4 const &mat, vec3 const *in, vec3 *out,
+                                int count)
 {
-    float st = sinf(theta);
-    float ct = cosf(theta);
+#if defined __SSE__
+    transform3_sse(mat, in, out, count, true);
+#else
+    for (int n = 0; n < count; n++)
+        out[n] = mat * vec4(in[n].x, in[n].y, in[n].z, 1.0f);
+#endif
+}
 
-    float len = sqrtf(x * x + y * y + z * z);
-    float invlen = len ? 1.0f / len : 0.0f;
-    x *= invlen;
-    y *= invlen;
-    z *= invlen;
+template<> void transform_dir(mat4 const &mat, vec3 const *in, vec3 *out,
+                              int count)
+{
+#if defined __SSE__
+    transform3_sse(mat, in, out, count, false);
+#else
+    for (int n = 0; n < count; n++)
+        out[n] = mat * vec4(in[n].x, in[n].y, in[n].z, 0.0f);
+#endif
+}
 
-    float mtx = (1.0f - ct) * x;
-    float mty = (1.0f - ct) * y;
-    float mtz = (1.0f - ct) * z;
+/* Four normals at once, normalized like Vec3::normalize(): the squared
+ * length is summed in the same order and a zero length leaves the vector
+ * unchanged */
+template<> void transform_normal(mat4 const &mat, vec3 const *in, vec3 *out,
+                                 int count)
+{
+    mat3 nm = normal_matrix_unscaled(mat);
+    int n = 0;
 
-    mat4 ret(1.0f);
+#if defined __SSE__
+    __m128 m[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            m[i][j] = _mm_set1_ps(nm[i][j]);
 
-    ret[0][0] = x * mtx + ct;
-    ret[0][1] = x * mty + st * z;
-    ret[0][2] = x * mtz - st * y;
+    __m128 const zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    for ( ; n + 4 <= count; n += 4)
+    {
+        __m128 x, y, z, ret[3];
+        load3_sse(&in[n][0], x, y, z);
+        for (int j = 0; j < 3; j++)
+        {
+            ret[j] = _mm_mul_ps(m[0][j], x);
+            ret[j] = _mm_add_ps(ret[j], _mm_mul_ps(m[1][j], y));
+            ret[j] = _mm_add_ps(ret[j], _mm_mul_ps(m[2][j], z));
+        }
 
-    ret[1][0] = y * mtx - st * z;
-    ret[1][1] = y * mty + ct;
-    ret[1][2] = y * mtz + st * x;
+        __m128 l = _mm_mul_ps(ret[0], ret[0]);
+        l = _mm_add_ps(l, _mm_mul_ps(ret[1], ret[1]));
+        l = _mm_add_ps(l, _mm_mul_ps(ret[2], ret[2]));
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(l));
+        inv = _mm_or_ps(_mm_and_ps(_mm_cmpeq_ps(l, zero), one),
+                        _mm_andnot_ps(_mm_cmpeq_ps(l, zero), inv));
 
-    ret[2][0] = z * mtx + st * y;
-    ret[2][1] = z * mty - st * x;
-    ret[2][2] = z * mtz + ct;
+        store3_sse(&out[n][0], _mm_mul_ps(ret[0], inv),
+                   _mm_mul_ps(ret[1], inv), _mm_mul_ps(ret[2], inv));
+    }
+#endif
 
-    return ret;
+    for ( ; n < count; n++)
+        out[n] = (nm * in[n]).normalize();
+}
+
+/*
+ * Aligned variants: one element per register with aligned loads, and
+ * aligned or non-temporal stores. The padding lane of avec3 is loaded
+ * but does not contribute to the result.
+ */
+void transform(mat4 const &mat, avec4 const *in, avec4 *out, int count)
+{
+#if defined __SSE__
+    __m128 col[4];
+    for (int i = 0; i < 4; i++)
+        col[i] = _mm_loadu_ps(&mat[i][0]);
+
+    for (int n = 0; n < count; n++)
+        _mm_store_ps(&out[n][0], mul_sse(col, _mm_load_ps(&in[n][0])));
+#else
+    for (int n = 0; n < count; n++)
+        out[n] = mat * in[n];
+#endif
+}
+
+void transform_stream(mat4 const &mat, avec4 const *in, avec4 *out,
+                      int count)
+{
+#if defined __SSE__
+    __m128 col[4];
+    for (int i = 0; i < 4; i++)
+        col[i] = _mm_loadu_ps(&mat[i][0]);
+
+    for (int n = 0; n < count; n++)
+        _mm_stream_ps(&out[n][0], mul_sse(col, _mm_load_ps(&in[n][0])));
+    /* Order the streaming stores before any later store */
+    _mm_sfence();
+#else
+    for (int n = 0; n < count; n++)
+        out[n] = mat * in[n];
+#endif
+}
+
+static void transform3_aligned(mat4 const &mat, avec3 const *in, avec3 *out,
+                               int count, bool point)
+{
+#if defined __SSE__
+    __m128 col[4];
+    for (int i = 0; i < 4; i++)
+        col[i] = _mm_loadu_ps(&mat[i][0]);
+
+    for (int n = 0; n < count; n++)
+        _mm_store_ps(&out[n][0], mul3_sse(col, _mm_load_ps(&in[n][0]), point));
+#else
+    for (int n = 0; n < count; n++)
+        out[n] = vec3(mat * vec4(in[n].value.x, in[n].value.y,
+                                 in[n].value.z, point ? 1.0f : 0.0f));
+#endif
+}
+
+void transform_point(mat4 const &mat, avec3 const *in, avec3 *out, int count)
+{
+    transform3_aligned(mat, in, out, count, true);
+}
+
+void transform_dir(mat4 const &mat, avec3 const *in, avec3 *out, int count)
+{
+    transform3_aligned(mat, in, out, count, false);
 }
 
 } /* namespace lol */
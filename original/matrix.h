@@ -17,6 +17,11 @@
 #define __LOL_MATRIX_H__
 
 #include <cmath>
+#include <type_traits>
+
+#include "lol/ctmath.h"
+#include "lol/fastmath.h"
+#include "lol/stats.h"
 
 namespace lol {
 
@@ -63,8 +68,12 @@ namespace lol {
   }
 
 #define OPERATORS(elems)                                                       \
-  inline T &operator[](int n) { return *(&x + n); }                            \
-  inline T const &operator[](int n) const { return *(&x + n); }                \
+  inline constexpr T &operator[](int n) {                                      \
+    return LOL_CONSTANT_EVALUATED() ? elem(*this, n) : *(&x + n);              \
+  }                                                                            \
+  inline constexpr T const &operator[](int n) const {                          \
+    return LOL_CONSTANT_EVALUATED() ? elem(*this, n) : *(&x + n);              \
+  }                                                                            \
                                                                                \
   VECTOR_OP(elems, -)                                                          \
   VECTOR_OP(elems, +)                                                          \
@@ -103,7 +112,29 @@ namespace lol {
                                                                                \
   inline float len() const {                                                   \
     using namespace std;                                                       \
+    LOL_STATS_SCOPE(VecLen);                                                   \
     return sqrtf((float)sqlen());                                              \
+  }                                                                            \
+                                                                               \
+  /* See fastmath.h for the precision of the fast versions */                  \
+  inline float len(precise_t) const { return len(); }                          \
+  inline float len(fast_t) const {                                             \
+    float l = (float)sqlen();                                                  \
+    return l ? l * rsqrt(l, fast) : 0.0f;                                      \
+  }                                                                            \
+                                                                               \
+  template <typename P = precise_t> inline float inv_len(P p = P()) const {    \
+    return rsqrt((float)sqlen(), p);                                           \
+  }                                                                            \
+                                                                               \
+  /* The zero vector is returned unchanged. Float vectors only: the scale    \
+   * factor of an integer vector would truncate to 0 */                        \
+  template <typename P = precise_t, typename U = T,                            \
+            typename std::enable_if<std::is_floating_point<U>::value,          \
+                                    int>::type = 0>                            \
+  inline Vec##elems<T> normalize(P p = P()) const {                            \
+    float l = (float)sqlen();                                                  \
+    return l ? *this * (T)rsqrt(l, p) : *this;                                 \
   }
 
 template <typename T> struct Vec2;
@@ -112,14 +143,17 @@ template <typename T> struct Vec4;
 
 template <typename T> struct Vec2 {
   inline Vec2() {}
-  inline Vec2(T val) { x = y = val; }
-  inline Vec2(T _x, T _y) {
-    x = _x;
-    y = _y;
-  }
+  inline constexpr Vec2(T val) : x(val), y(val) {}
+  inline constexpr Vec2(T _x, T _y) : x(_x), y(_y) {}
 
   OPERATORS(2)
 
+  /* Pointer arithmetic across the unions is not allowed in constant
+   * expressions, so operator[] names the member instead */
+  template <typename V> static constexpr auto &elem(V &that, int n) {
+    return n ? that.y : that.x;
+  }
+
   union {
     T x;
     T a;
@@ -137,15 +171,15 @@ typedef Vec2<int> vec2i;
 
 template <typename T> struct Vec3 {
   inline Vec3() {}
-  inline Vec3(T val) { x = y = z = val; }
-  inline Vec3(T _x, T _y, T _z) {
-    x = _x;
-    y = _y;
-    z = _z;
-  }
+  inline constexpr Vec3(T val) : x(val), y(val), z(val) {}
+  inline constexpr Vec3(T _x, T _y, T _z) : x(_x), y(_y), z(_z) {}
 
   OPERATORS(3)
 
+  template <typename V> static constexpr auto &elem(V &that, int n) {
+    return n == 0 ? that.x : n == 1 ? that.y : that.z;
+  }
+
   union {
     T x;
     T a;
@@ -168,16 +202,15 @@ typedef Vec3<int> vec3i;
 
 template <typename T> struct Vec4 {
   inline Vec4() {}
-  inline Vec4(T val) { x = y = z = w = val; }
-  inline Vec4(T _x, T _y, T _z, T _w) {
-    x = _x;
-    y = _y;
-    z = _z;
-    w = _w;
-  }
+  inline constexpr Vec4(T val) : x(val), y(val), z(val), w(val) {}
+  inline constexpr Vec4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w) {}
 
   OPERATORS(4)
 
+  template <typename V> static constexpr auto &elem(V &that, int n) {
+    return n == 0 ? that.x : n == 1 ? that.y : n == 2 ? that.z : that.w;
+  }
+
   union {
     T x;
     T a;
@@ -227,70 +260,259 @@ GLOBALS(2)
 GLOBALS(3)
 GLOBALS(4)
 
+template <typename T> struct Mat4;
+typedef Mat4<float> mat4;
+typedef Mat4<int> mat4i;
+
+namespace details {
+/* Runtime mat4 product, see matrix.cpp. ret may alias a or b. */
+void mul_mat4(mat4 &ret, mat4 const &a, mat4 const &b);
+
+/* libm at runtime, the double precision ct_* functions during constant
+ * evaluation */
+template <typename T> constexpr T sqrt(T x) {
+  return LOL_CONSTANT_EVALUATED() ? (T)ct_sqrt(x) : (T)std::sqrt(x);
+}
+
+/* Same, with the fastmath.h approximations for float and a fast policy */
+template <typename T, typename P>
+constexpr void sincos(T x, T &s, T &c, P policy) {
+  if (LOL_CONSTANT_EVALUATED()) {
+    s = (T)ct_sin(x);
+    c = (T)ct_cos(x);
+  } else if constexpr (std::is_same<T, float>::value) {
+    lol::sincos(x, s, c, policy);
+  } else {
+    s = (T)std::sin(x);
+    c = (T)std::cos(x);
+  }
+}
+
+template <typename T, typename P> constexpr T tan(T x, P policy) {
+  if (LOL_CONSTANT_EVALUATED())
+    return (T)ct_tan(x);
+  else if constexpr (std::is_same<T, float>::value)
+    return lol::tan(x, policy);
+  else
+    return (T)std::tan(x);
+}
+
+/* 1 / sqrt(x), or 0 when x is 0 */
+template <typename T, typename P> constexpr T inv_sqrt(T x, P policy) {
+  if (!x)
+    return (T)0;
+  if (LOL_CONSTANT_EVALUATED())
+    return (T)1 / (T)ct_sqrt(x);
+  else if constexpr (std::is_same<T, float>::value &&
+                     std::is_same<P, fast_t>::value)
+    return rsqrt(x, policy);
+  else
+    return (T)1 / (T)std::sqrt(x);
+}
+} /* namespace details */
+
 template <typename T> struct Mat4 {
   inline Mat4() {}
-  inline Mat4(T val) {
-    for (int j = 0; j < 4; j++)
-      for (int i = 0; i < 4; i++)
-        v[i][j] = (i == j) ? val : 0;
+  inline constexpr Mat4(T val)
+      : v{Vec4<T>(val, 0, 0, 0), Vec4<T>(0, val, 0, 0), Vec4<T>(0, 0, val, 0),
+          Vec4<T>(0, 0, 0, val)} {}
+  inline constexpr Mat4(Vec4<T> v0, Vec4<T> v1, Vec4<T> v2, Vec4<T> v3)
+      : v{v0, v1, v2, v3} {}
+
+  inline constexpr Vec4<T> &operator[](int n) { return v[n]; }
+  inline constexpr Vec4<T> const &operator[](int n) const { return v[n]; }
+
+  /* 2x2 minors of the first two (s) and last two (c) columns, shared by
+   * det() and the cofactors in try_invert() */
+  static constexpr void minors(Mat4<T> const &m, T s[6], T c[6]) {
+    s[0] = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+    s[1] = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+    s[2] = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+    s[3] = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+    s[4] = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+    s[5] = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+    c[0] = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+    c[1] = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+    c[2] = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+    c[3] = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+    c[4] = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+    c[5] = m[2][2] * m[3][3] - m[3][2] * m[2][3];
   }
-  inline Mat4(Vec4<T> v0, Vec4<T> v1, Vec4<T> v2, Vec4<T> v3) {
-    v[0] = v0;
-    v[1] = v1;
-    v[2] = v2;
-    v[3] = v3;
+
+  static constexpr T det_minors(T const s[6], T const c[6]) {
+    return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] -
+           s[4] * c[1] + s[5] * c[0];
   }
 
-  inline Vec4<T> &operator[](int n) { return v[n]; }
-  inline Vec4<T> const &operator[](int n) const { return v[n]; }
+  inline constexpr T det() const {
+    T s[6] = {}, c[6] = {};
+    minors(*this, s, c);
+    return det_minors(s, c);
+  }
 
-  T det() const;
   Mat4<T> invert() const;
+  /* Store the inverse in ret and return the determinant. ret is left
+   * untouched when the determinant is zero. */
+  T try_invert(Mat4<T> &ret) const;
+
+  static constexpr Mat4<T> ortho(T left, T right, T bottom, T top, T near,
+                                 T far) {
+    T invrl = (right != left) ? (T)1 / (right - left) : (T)0;
+    T invtb = (top != bottom) ? (T)1 / (top - bottom) : (T)0;
+    T invfn = (far != near) ? (T)1 / (far - near) : (T)0;
+
+    Mat4<T> ret(0);
+    ret[0][0] = (T)2 * invrl;
+    ret[1][1] = (T)2 * invtb;
+    ret[2][2] = (T)-2 * invfn;
+    ret[3][0] = -(right + left) * invrl;
+    ret[3][1] = -(top + bottom) * invtb;
+    ret[3][2] = -(far + near) * invfn;
+    ret[3][3] = (T)1;
+    return ret;
+  }
+
+  static constexpr Mat4<T> frustum(T left, T right, T bottom, T top, T near,
+                                   T far) {
+    T invrl = (right != left) ? (T)1 / (right - left) : (T)0;
+    T invtb = (top != bottom) ? (T)1 / (top - bottom) : (T)0;
+    T invfn = (far != near) ? (T)1 / (far - near) : (T)0;
+
+    Mat4<T> ret(0);
+    ret[0][0] = (T)2 * near * invrl;
+    ret[1][1] = (T)2 * near * invtb;
+    ret[2][0] = (right + left) * invrl;
+    ret[2][1] = (top + bottom) * invtb;
+    ret[2][2] = -(far + near) * invfn;
+    ret[2][3] = (T)-1;
+    ret[3][2] = (T)-2 * far * near * invfn;
+    return ret;
+  }
+
+  /* Constant evaluation uses the ct_* approximations, see ctmath.h, and
+   * a fast policy the fastmath.h ones at runtime */
+  template <typename P = precise_t>
+  static constexpr Mat4<T> perspective(T theta, T width, T height, T near,
+                                       T far, P policy = P()) {
+    T t1 = details::tan(theta / (T)2, policy);
+    T t2 = t1 * height / width;
+
+    return frustum(-near * t1, near * t1, -near * t2, near * t2, near, far);
+  }
+
+  static constexpr Mat4<T> translate(T x, T y, T z) {
+    Mat4<T> ret(1);
+    ret[3][0] = x;
+    ret[3][1] = y;
+    ret[3][2] = z;
+    return ret;
+  }
 
-  static Mat4<T> ortho(T left, T right, T bottom, T top, T near, T far);
-  static Mat4<T> frustum(T left, T right, T bottom, T top, T near, T far);
-  static Mat4<T> perspective(T theta, T width, T height, T near, T far);
-  static Mat4<T> translate(T x, T y, T z);
-  static Mat4<T> rotate(T theta, T x, T y, T z);
+  template <typename P = precise_t>
+  static constexpr Mat4<T> rotate(T theta, T x, T y, T z, P policy = P()) {
+    LOL_STATS_COUNT(Mat4Rotate);
+
+    T st = 0, ct = 0;
+    details::sincos(theta, st, ct, policy);
+
+    T invlen = details::inv_sqrt(x * x + y * y + z * z, policy);
+    x *= invlen;
+    y *= invlen;
+    z *= invlen;
+
+    T mtx = ((T)1 - ct) * x;
+    T mty = ((T)1 - ct) * y;
+    T mtz = ((T)1 - ct) * z;
+
+    Mat4<T> ret(1);
+
+    ret[0][0] = x * mtx + ct;
+    ret[0][1] = x * mty + st * z;
+    ret[0][2] = x * mtz - st * y;
+
+    ret[1][0] = y * mtx - st * z;
+    ret[1][1] = y * mty + ct;
+    ret[1][2] = y * mtz + st * x;
+
+    ret[2][0] = z * mtx + st * y;
+    ret[2][1] = z * mty - st * x;
+    ret[2][2] = z * mtz + ct;
+
+    return ret;
+  }
 
   void printf() const;
 
-  inline Mat4<T> operator+(Mat4<T> const val) const {
-    Mat4<T> ret;
+  inline constexpr Mat4<T> operator+(Mat4<T> const &val) const {
+    Mat4<T> ret(0);
     for (int j = 0; j < 4; j++)
       for (int i = 0; i < 4; i++)
         ret[i][j] = v[i][j] + val[i][j];
     return ret;
   }
 
-  inline Mat4<T> operator+=(Mat4<T> const val) { return *this = *this + val; }
+  inline constexpr Mat4<T> &operator+=(Mat4<T> const &val) {
+    for (int j = 0; j < 4; j++)
+      for (int i = 0; i < 4; i++)
+        v[i][j] += val[i][j];
+    return *this;
+  }
 
-  inline Mat4<T> operator-(Mat4<T> const val) const {
-    Mat4<T> ret;
+  inline constexpr Mat4<T> operator-(Mat4<T> const &val) const {
+    Mat4<T> ret(0);
     for (int j = 0; j < 4; j++)
       for (int i = 0; i < 4; i++)
         ret[i][j] = v[i][j] - val[i][j];
     return ret;
   }
 
-  inline Mat4<T> operator-=(Mat4<T> const val) { return *this = *this - val; }
-
-  inline Mat4<T> operator*(Mat4<T> const val) const {
-    Mat4<T> ret;
+  inline constexpr Mat4<T> &operator-=(Mat4<T> const &val) {
     for (int j = 0; j < 4; j++)
+      for (int i = 0; i < 4; i++)
+        v[i][j] -= val[i][j];
+    return *this;
+  }
+
+  /* Column i of the product is *this applied to column i of val. At
+   * runtime, float matrices use the SIMD product from matrix.cpp. */
+  inline constexpr Mat4<T> operator*(Mat4<T> const &val) const {
+    if constexpr (std::is_same<T, float>::value)
+      if (!LOL_CONSTANT_EVALUATED())
+        return mul_runtime(val);
+
+    Mat4<T> ret(0);
+    for (int i = 0; i < 4; i++)
+      ret[i] = *this * val[i];
+    return ret;
+  }
+
+  /* Row j of the product only depends on row j of *this, so the product
+   * can be written back one row at a time. */
+  inline constexpr Mat4<T> &operator*=(Mat4<T> const &val) {
+    if constexpr (std::is_same<T, float>::value)
+      if (!LOL_CONSTANT_EVALUATED()) {
+        details::mul_mat4(*this, *this, val);
+        return *this;
+      }
+
+    if (&val == this)
+      return *this = *this * val;
+
+    for (int j = 0; j < 4; j++) {
+      T row[4] = {v[0][j], v[1][j], v[2][j], v[3][j]};
       for (int i = 0; i < 4; i++) {
         T tmp = 0;
         for (int k = 0; k < 4; k++)
-          tmp += v[k][j] * val[i][k];
-        ret[i][j] = tmp;
+          tmp += row[k] * val[i][k];
+        v[i][j] = tmp;
       }
-    return ret;
+    }
+    return *this;
   }
 
-  inline Mat4<T> operator*=(Mat4<T> const val) { return *this = *this * val; }
-
-  inline Vec4<T> operator*(Vec4<T> const val) const {
-    Vec4<T> ret;
+  inline constexpr Vec4<T> operator*(Vec4<T> const &val) const {
+    Vec4<T> ret(0);
     for (int j = 0; j < 4; j++) {
       T tmp = 0;
       for (int i = 0; i < 4; i++)
@@ -301,10 +523,156 @@ template <typename T> struct Mat4 {
   }
 
   Vec4<T> v[4];
+
+private:
+  inline Mat4<T> mul_runtime(Mat4<T> const &val) const {
+    Mat4<T> ret;
+    details::mul_mat4(ret, *this, val);
+    return ret;
+  }
 };
 
-typedef Mat4<float> mat4;
-typedef Mat4<int> mat4i;
+template <typename T> struct Mat3 {
+  inline Mat3() {}
+  inline constexpr Mat3(T val)
+      : v{Vec3<T>(val, 0, 0), Vec3<T>(0, val, 0), Vec3<T>(0, 0, val)} {}
+  inline constexpr Mat3(Vec3<T> v0, Vec3<T> v1, Vec3<T> v2) : v{v0, v1, v2} {}
+
+  /* The upper left 3x3 of m */
+  explicit inline constexpr Mat3(Mat4<T> const &m)
+      : v{Vec3<T>(m[0][0], m[0][1], m[0][2]),
+          Vec3<T>(m[1][0], m[1][1], m[1][2]),
+          Vec3<T>(m[2][0], m[2][1], m[2][2])} {}
+
+  inline constexpr Vec3<T> &operator[](int n) { return v[n]; }
+  inline constexpr Vec3<T> const &operator[](int n) const { return v[n]; }
+
+  /* Transpose of the matrix of cofactors: det() times the inverse */
+  inline constexpr Mat3<T> adjugate() const {
+    Mat3<T> ret(0);
+    for (int i = 0; i < 3; i++) {
+      int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+      for (int j = 0; j < 3; j++) {
+        int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        ret[j][i] = v[i1][j1] * v[i2][j2] - v[i2][j1] * v[i1][j2];
+      }
+    }
+    return ret;
+  }
+
+  inline constexpr T det() const {
+    return v[0][0] * (v[1][1] * v[2][2] - v[2][1] * v[1][2]) +
+           v[1][0] * (v[2][1] * v[0][2] - v[0][1] * v[2][2]) +
+           v[2][0] * (v[0][1] * v[1][2] - v[1][1] * v[0][2]);
+  }
+
+  inline constexpr Mat3<T> transpose() const {
+    Mat3<T> ret(0);
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        ret[i][j] = v[j][i];
+    return ret;
+  }
+
+  inline constexpr Mat3<T> operator*(T const &val) const {
+    Mat3<T> ret(0);
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        ret[i][j] = v[i][j] * val;
+    return ret;
+  }
+
+  inline constexpr Vec3<T> operator*(Vec3<T> const &val) const {
+    Vec3<T> ret(0);
+    for (int j = 0; j < 3; j++) {
+      T tmp = 0;
+      for (int i = 0; i < 3; i++)
+        tmp += v[i][j] * val[i];
+      ret[j] = tmp;
+    }
+    return ret;
+  }
+
+  inline constexpr Mat3<T> operator*(Mat3<T> const &val) const {
+    Mat3<T> ret(0);
+    for (int i = 0; i < 3; i++)
+      ret[i] = *this * val[i];
+    return ret;
+  }
+
+  Vec3<T> v[3];
+};
+
+typedef Mat3<float> mat3;
+
+/*
+ * Normal matrices. Normals transform by the inverse transpose of the upper
+ * 3x3 of the model matrix, which is its cofactor matrix, the transpose of
+ * the adjugate, divided by its determinant. When the normals are
+ * renormalized anyway, only the sign of the determinant matters, so
+ * normal_matrix_unscaled() does without the division.
+ */
+
+/* Zero when the 3x3 is singular */
+template <typename T>
+inline constexpr Mat3<T> normal_matrix(Mat4<T> const &m) {
+  Mat3<T> a(m);
+  T d = a.det();
+  return d ? a.adjugate().transpose() * ((T)1 / d) : Mat3<T>(0);
+}
+
+/* normal_matrix() times the absolute value of the determinant */
+template <typename T>
+inline constexpr Mat3<T> normal_matrix_unscaled(Mat4<T> const &m) {
+  Mat3<T> a(m);
+  Mat3<T> ret = a.adjugate().transpose();
+  return a.det() < (T)0 ? ret * (T)-1 : ret;
+}
+
+/*
+ * Batch transforms: out[n] = mat * in[n] for n in [0, count). Points are
+ * extended with w = 1 and directions with w = 0; the resulting w is dropped
+ * without any perspective division. in and out may be the same array.
+ */
+template <typename T>
+void transform(Mat4<T> const &mat, Vec4<T> const *in, Vec4<T> *out,
+               int count) {
+  for (int n = 0; n < count; n++)
+    out[n] = mat * in[n];
+}
+
+template <typename T>
+void transform_point(Mat4<T> const &mat, Vec3<T> const *in, Vec3<T> *out,
+                     int count) {
+  for (int n = 0; n < count; n++)
+    out[n] = mat * Vec4<T>(in[n].x, in[n].y, in[n].z, 1);
+}
+
+template <typename T>
+void transform_dir(Mat4<T> const &mat, Vec3<T> const *in, Vec3<T> *out,
+                   int count) {
+  for (int n = 0; n < count; n++)
+    out[n] = mat * Vec4<T>(in[n].x, in[n].y, in[n].z, 0);
+}
+
+/* out[n] = (normal_matrix(mat) * in[n]).normalize(), with the unscaled
+ * matrix since the result is normalized; zero normals stay zero */
+template <typename T>
+void transform_normal(Mat4<T> const &mat, Vec3<T> const *in, Vec3<T> *out,
+                      int count) {
+  Mat3<T> nm = normal_matrix_unscaled(mat);
+  for (int n = 0; n < count; n++)
+    out[n] = (nm * in[n]).normalize();
+}
+
+template <>
+void transform(mat4 const &mat, vec4 const *in, vec4 *out, int count);
+template <>
+void transform_point(mat4 const &mat, vec3 const *in, vec3 *out, int count);
+template <>
+void transform_dir(mat4 const &mat, vec3 const *in, vec3 *out, int count);
+template <>
+void transform_normal(mat4 const &mat, vec3 const *in, vec3 *out, int count);
 
 } /* namespace lol */
 
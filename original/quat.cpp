@@ -0,0 +1,82 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
+#include "lol/quat.h"
+
+namespace lol
+{
+
+/*
+ * Four quaternions per iteration. They are transposed to wwww xxxx yyyy
+ * zzzz, the matrix terms are computed in the same order as the scalar
+ * conversion, and each group of four columns is transposed back before
+ * being stored. Results are identical to Mat4<T>(quat).
+ */
+template<> void to_mat4(quat const *in, mat4 *out, int count)
+{
+    int n = 0;
+#if defined __SSE__
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const col3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+    for ( ; n + 4 <= count; n += 4)
+    {
+        __m128 w = _mm_loadu_ps(&in[n].w);
+        __m128 x = _mm_loadu_ps(&in[n + 1].w);
+        __m128 y = _mm_loadu_ps(&in[n + 2].w);
+        __m128 z = _mm_loadu_ps(&in[n + 3].w);
+        _MM_TRANSPOSE4_PS(w, x, y, z);
+
+        __m128 x2 = _mm_add_ps(x, x);
+        __m128 y2 = _mm_add_ps(y, y);
+        __m128 z2 = _mm_add_ps(z, z);
+        __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2);
+        __m128 zz = _mm_mul_ps(z, z2), xy = _mm_mul_ps(x, y2);
+        __m128 xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2);
+        __m128 wz = _mm_mul_ps(w, z2);
+
+        __m128 c[3][4];
+        c[0][0] = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+        c[0][1] = _mm_add_ps(xy, wz);
+        c[0][2] = _mm_sub_ps(xz, wy);
+        c[1][0] = _mm_sub_ps(xy, wz);
+        c[1][1] = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+        c[1][2] = _mm_add_ps(yz, wx);
+        c[2][0] = _mm_add_ps(xz, wy);
+        c[2][1] = _mm_sub_ps(yz, wx);
+        c[2][2] = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+        for (int i = 0; i < 3; i++)
+        {
+            c[i][3] = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(c[i][0], c[i][1], c[i][2], c[i][3]);
+            for (int k = 0; k < 4; k++)
+                _mm_storeu_ps(&out[n + k][i][0], c[i][k]);
+        }
+        for (int k = 0; k < 4; k++)
+            _mm_storeu_ps(&out[n + k][3][0], col3);
+    }
+#endif
+
+    for ( ; n < count; n++)
+        out[n] = mat4(in[n]);
+}
+
+} /* namespace lol */
+
@@ -0,0 +1,181 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The Quat class
+// --------------
+// A rotation stored as a quaternion w + xi + yj + zk. Composing two
+// rotations costs 16 multiplies instead of 64 for Mat4, and rotating a
+// Vec3 costs 15. Only unit quaternions represent rotations; the rotation
+// functions assume their operands are normalized.
+//
+
+#if !defined __LOL_QUAT_H__
+#define __LOL_QUAT_H__
+
+#include "lol/matrix.h"
+
+namespace lol {
+
+template <typename T> struct Quat {
+  inline Quat() {}
+  inline constexpr Quat(T val) : w(val), x(0), y(0), z(0) {}
+  inline constexpr Quat(T _w, T _x, T _y, T _z) : w(_w), x(_x), y(_y), z(_z) {}
+
+  /* The rotation part of mat, which must be orthonormal */
+  explicit inline constexpr Quat(Mat4<T> const &mat) : w(0), x(0), y(0), z(0) {
+    T tr = mat[0][0] + mat[1][1] + mat[2][2];
+
+    /* Divide by the largest component to stay accurate near 180 degrees */
+    if (tr > 0) {
+      T s = details::sqrt(tr + (T)1) * (T)2;
+      w = s / (T)4;
+      x = (mat[1][2] - mat[2][1]) / s;
+      y = (mat[2][0] - mat[0][2]) / s;
+      z = (mat[0][1] - mat[1][0]) / s;
+    } else if (mat[0][0] > mat[1][1] && mat[0][0] > mat[2][2]) {
+      T s = details::sqrt((T)1 + mat[0][0] - mat[1][1] - mat[2][2]) * (T)2;
+      w = (mat[1][2] - mat[2][1]) / s;
+      x = s / (T)4;
+      y = (mat[1][0] + mat[0][1]) / s;
+      z = (mat[2][0] + mat[0][2]) / s;
+    } else if (mat[1][1] > mat[2][2]) {
+      T s = details::sqrt((T)1 + mat[1][1] - mat[0][0] - mat[2][2]) * (T)2;
+      w = (mat[2][0] - mat[0][2]) / s;
+      x = (mat[1][0] + mat[0][1]) / s;
+      y = s / (T)4;
+      z = (mat[2][1] + mat[1][2]) / s;
+    } else {
+      T s = details::sqrt((T)1 + mat[2][2] - mat[0][0] - mat[1][1]) * (T)2;
+      w = (mat[0][1] - mat[1][0]) / s;
+      x = (mat[2][0] + mat[0][2]) / s;
+      y = (mat[2][1] + mat[1][2]) / s;
+      z = s / (T)4;
+    }
+  }
+
+  /* The rotation matrix of a unit quaternion */
+  explicit inline constexpr operator Mat4<T>() const {
+    T x2 = x + x, y2 = y + y, z2 = z + z;
+    T xx = x * x2, yy = y * y2, zz = z * z2;
+    T xy = x * y2, xz = x * z2, yz = y * z2;
+    T wx = w * x2, wy = w * y2, wz = w * z2;
+
+    return Mat4<T>(Vec4<T>((T)1 - (yy + zz), xy + wz, xz - wy, 0),
+                   Vec4<T>(xy - wz, (T)1 - (xx + zz), yz + wx, 0),
+                   Vec4<T>(xz + wy, yz - wx, (T)1 - (xx + yy), 0),
+                   Vec4<T>(0, 0, 0, 1));
+  }
+
+  /* Same arguments and result as Mat4::rotate() */
+  template <typename P = precise_t>
+  static constexpr Quat<T> rotate(T theta, T x, T y, T z, P policy = P()) {
+    T st = 0, ct = 0;
+    details::sincos(theta / (T)2, st, ct, policy);
+
+    /* The precise path divides by the length rather than multiplying by
+     * its inverse, which rounds differently */
+    T s = 0;
+    if constexpr (std::is_same<P, fast_t>::value) {
+      s = st * details::inv_sqrt(x * x + y * y + z * z, policy);
+    } else {
+      T len = details::sqrt(x * x + y * y + z * z);
+      s = len ? st / len : (T)0;
+    }
+    return Quat<T>(ct, x * s, y * s, z * s);
+  }
+
+  inline constexpr Quat<T> operator+(Quat<T> const &val) const {
+    return Quat<T>(w + val.w, x + val.x, y + val.y, z + val.z);
+  }
+
+  inline constexpr Quat<T> operator-(Quat<T> const &val) const {
+    return Quat<T>(w - val.w, x - val.x, y - val.y, z - val.z);
+  }
+
+  inline constexpr Quat<T> operator*(T const &val) const {
+    return Quat<T>(w * val, x * val, y * val, z * val);
+  }
+
+  /* Applies val first, then *this, as with Mat4 */
+  inline constexpr Quat<T> operator*(Quat<T> const &val) const {
+    return Quat<T>(w * val.w - x * val.x - y * val.y - z * val.z,
+                   w * val.x + x * val.w + y * val.z - z * val.y,
+                   w * val.y - x * val.z + y * val.w + z * val.x,
+                   w * val.z + x * val.y - y * val.x + z * val.w);
+  }
+
+  inline constexpr Quat<T> &operator*=(Quat<T> const &val) {
+    return *this = *this * val;
+  }
+
+  /* v + 2w (q x v) + 2 q x (q x v), with q the vector part */
+  inline constexpr Vec3<T> operator*(Vec3<T> const &val) const {
+    T tx = (T)2 * (y * val.z - z * val.y);
+    T ty = (T)2 * (z * val.x - x * val.z);
+    T tz = (T)2 * (x * val.y - y * val.x);
+    return Vec3<T>(val.x + w * tx + (y * tz - z * ty),
+                   val.y + w * ty + (z * tx - x * tz),
+                   val.z + w * tz + (x * ty - y * tx));
+  }
+
+  inline constexpr Quat<T> conjugate() const { return Quat<T>(w, -x, -y, -z); }
+
+  inline constexpr T sqlen() const { return w * w + x * x + y * y + z * z; }
+
+  inline constexpr T len() const { return details::sqrt(sqlen()); }
+
+  /* The zero quaternion is returned unchanged */
+  template <typename P = precise_t>
+  inline constexpr Quat<T> normalize(P policy = P()) const {
+    T l = sqlen();
+    return l ? *this * details::inv_sqrt(l, policy) : *this;
+  }
+
+  /* The conjugate for unit quaternions */
+  inline constexpr Quat<T> invert() const {
+    T l = sqlen();
+    return l ? conjugate() * ((T)1 / l) : *this;
+  }
+
+  T w, x, y, z;
+};
+
+typedef Quat<float> quat;
+
+template <typename T>
+inline constexpr T dot(Quat<T> const &a, Quat<T> const &b) {
+  return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/* Normalized linear interpolation along the shorter arc. Much cheaper than
+ * slerp and close to it for the small steps of animation blending, but
+ * the angular speed is not constant. */
+template <typename T, typename P = precise_t>
+inline constexpr Quat<T> nlerp(Quat<T> const &a, Quat<T> const &b, T t,
+                               P policy = P()) {
+  T u = dot(a, b) < 0 ? -t : t;
+  return (a * ((T)1 - t) + b * u).normalize(policy);
+}
+
+/*
+ * Batch conversion: out[n] = Mat4<T>(in[n]) for n in [0, count).
+ */
+template <typename T>
+void to_mat4(Quat<T> const *in, Mat4<T> *out, int count) {
+  for (int n = 0; n < count; n++)
+    out[n] = Mat4<T>(in[n]);
+}
+
+template <> void to_mat4(quat const *in, mat4 *out, int count);
+
+} /* namespace lol */
+
+#endif // __LOL_QUAT_H__
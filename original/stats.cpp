@@ -0,0 +1,203 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+#include "lol/stats.h"
+
+using namespace std;
+
+namespace lol
+{
+
+static char const *const names[Stats::Count] =
+{
+    "mat4_invert", "mat4_mul", "mat4_rotate", "vec_len",
+};
+
+char const *Stats::name(int op)
+{
+    return names[op];
+}
+
+/*
+ * Snapshots
+ */
+
+StatsSnapshot::StatsSnapshot()
+{
+    for (int op = 0; op < Stats::Count; op++)
+    {
+        calls[op] = 0;
+        for (int b = 0; b < Stats::buckets; b++)
+            histogram[op][b] = 0;
+    }
+}
+
+StatsSnapshot StatsSnapshot::operator-(StatsSnapshot const &prev) const
+{
+    StatsSnapshot ret;
+    for (int op = 0; op < Stats::Count; op++)
+    {
+        ret.calls[op] = calls[op] - prev.calls[op];
+        for (int b = 0; b < Stats::buckets; b++)
+            ret.histogram[op][b] = histogram[op][b] - prev.histogram[op][b];
+    }
+    return ret;
+}
+
+StatsSnapshot &StatsSnapshot::operator+=(StatsSnapshot const &that)
+{
+    for (int op = 0; op < Stats::Count; op++)
+    {
+        calls[op] += that.calls[op];
+        for (int b = 0; b < Stats::buckets; b++)
+            histogram[op][b] += that.histogram[op][b];
+    }
+    return *this;
+}
+
+string StatsSnapshot::to_json() const
+{
+    string ret = "{";
+    char buf[32];
+    for (int op = 0; op < Stats::Count; op++)
+    {
+        ret += op ? ", \"" : "\"";
+        ret += names[op];
+        snprintf(buf, sizeof(buf), "%llu", (unsigned long long)calls[op]);
+        ret += string("\": {\"calls\": ") + buf + ", \"histogram\": [";
+        for (int b = 0; b < Stats::buckets; b++)
+        {
+            snprintf(buf, sizeof(buf), b ? ", %llu" : "%llu",
+                     (unsigned long long)histogram[op][b]);
+            ret += buf;
+        }
+        ret += "]}";
+    }
+    return ret + "}";
+}
+
+/*
+ * Per-thread counters. Each thread's block lives in a global list until
+ * the thread exits, when its counts are folded into retired.
+ */
+
+static mutex lock;
+static vector<details::ThreadStats *> live;
+static StatsSnapshot retired;
+
+static void read(details::ThreadStats const *stats, StatsSnapshot &out)
+{
+    for (int op = 0; op < Stats::Count; op++)
+    {
+        out.calls[op] = stats->calls[op].load(memory_order_relaxed);
+        for (int b = 0; b < Stats::buckets; b++)
+            out.histogram[op][b] =
+                stats->histogram[op][b].load(memory_order_relaxed);
+    }
+}
+
+namespace
+{
+struct Registration
+{
+    details::ThreadStats *stats = nullptr;
+
+    ~Registration()
+    {
+        if (!stats)
+            return;
+
+        StatsSnapshot last;
+        read(stats, last);
+
+        unique_lock<mutex> l(lock);
+        retired += last;
+        for (size_t n = 0; n < live.size(); n++)
+            if (live[n] == stats)
+            {
+                live[n] = live.back();
+                live.pop_back();
+                break;
+            }
+        l.unlock();
+
+        details::thread_stats = nullptr;
+        delete stats;
+    }
+};
+} /* namespace */
+
+static thread_local Registration registration;
+
+details::ThreadStats *details::register_thread_stats()
+{
+    ThreadStats *stats = new ThreadStats;
+    for (int op = 0; op < Stats::Count; op++)
+    {
+        stats->calls[op].store(0, memory_order_relaxed);
+        for (int b = 0; b < Stats::buckets; b++)
+            stats->histogram[op][b].store(0, memory_order_relaxed);
+    }
+
+    {
+        unique_lock<mutex> l(lock);
+        live.push_back(stats);
+    }
+
+    registration.stats = stats;
+    thread_stats = stats;
+    return stats;
+}
+
+uint64_t details::stats_clock()
+{
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void details::stats_record(ThreadStats *stats, int op, uint64_t ns)
+{
+    int b = 0;
+    while (b < Stats::buckets - 1 && ns >> (b + 1))
+        b++;
+
+    atomic<uint64_t> &bucket = stats->histogram[op][b];
+    bucket.store(bucket.load(memory_order_relaxed) + 1,
+                 memory_order_relaxed);
+}
+
+void stats_snapshot(StatsSnapshot &total, vector<StatsSnapshot> *threads)
+{
+    unique_lock<mutex> l(lock);
+
+    total = retired;
+    if (threads)
+        threads->resize(live.size());
+
+    for (size_t n = 0; n < live.size(); n++)
+    {
+        StatsSnapshot one;
+        read(live[n], one);
+        total += one;
+        if (threads)
+            (*threads)[n] = one;
+    }
+}
+
+} /* namespace lol */
+
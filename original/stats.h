@@ -0,0 +1,143 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Math operation statistics
+// -------------------------
+// Building with LOL_STATS defined to 1 makes the instrumented operations
+// count their calls, per thread, and time one call in sample_rate into a
+// latency histogram. Otherwise LOL_STATS_SCOPE and LOL_STATS_COUNT expand
+// to nothing and cost nothing.
+//
+// Counters only grow. Take a snapshot each frame and subtract the
+// previous one to get per-frame numbers:
+//
+//     lol::StatsSnapshot now;
+//     lol::stats_snapshot(now);
+//     report((now - last).to_json());
+//     last = now;
+//
+// Operations that are constexpr, such as Mat4::rotate(), are counted but
+// not timed.
+//
+
+#if !defined __LOL_STATS_H__
+#define __LOL_STATS_H__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "lol/ctmath.h"
+
+#if !defined LOL_STATS
+#   define LOL_STATS 0
+#endif
+
+namespace lol {
+
+struct Stats {
+  enum Op { Mat4Invert, Mat4Mul, Mat4Rotate, VecLen, Count };
+
+  /* Bucket b of a histogram counts the samples that took [2^b, 2^(b+1))
+   * nanoseconds, the last one everything longer */
+  static int const buckets = 32;
+  static int const sample_rate = 64;
+
+  static char const *name(int op);
+};
+
+struct StatsSnapshot {
+  StatsSnapshot();
+
+  uint64_t calls[Stats::Count];
+  uint64_t histogram[Stats::Count][Stats::buckets];
+
+  StatsSnapshot operator-(StatsSnapshot const &prev) const;
+  StatsSnapshot &operator+=(StatsSnapshot const &that);
+
+  /* {"mat4_invert": {"calls": 12, "histogram": [0, 3, ...]}, ...} */
+  std::string to_json() const;
+};
+
+/* Sum over every thread that ever ran an instrumented operation, and if
+ * threads is not null one snapshot per thread still running */
+void stats_snapshot(StatsSnapshot &total,
+                    std::vector<StatsSnapshot> *threads = nullptr);
+
+namespace details {
+/* Written by its thread only, read by stats_snapshot() */
+struct ThreadStats {
+  std::atomic<uint64_t> calls[Stats::Count];
+  std::atomic<uint64_t> histogram[Stats::Count][Stats::buckets];
+};
+
+ThreadStats *register_thread_stats();
+uint64_t stats_clock();
+void stats_record(ThreadStats *stats, int op, uint64_t ns);
+
+inline thread_local ThreadStats *thread_stats = nullptr;
+
+inline ThreadStats *local_stats() {
+  ThreadStats *stats = thread_stats;
+  return stats ? stats : register_thread_stats();
+}
+
+/* Increment the call count and return it as it was */
+inline uint64_t stats_count(ThreadStats *stats, int op) {
+  uint64_t n = stats->calls[op].load(std::memory_order_relaxed);
+  stats->calls[op].store(n + 1, std::memory_order_relaxed);
+  return n;
+}
+
+class StatsScope {
+public:
+  inline explicit StatsScope(int _op)
+      : stats(local_stats()), op(_op), start(0) {
+    if (stats_count(stats, op) % Stats::sample_rate == 0)
+      start = stats_clock() | 1; /* never 0 */
+  }
+  inline ~StatsScope() {
+    if (start)
+      stats_record(stats, op, stats_clock() - start);
+  }
+
+  StatsScope(StatsScope const &) = delete;
+  StatsScope &operator=(StatsScope const &) = delete;
+
+private:
+  ThreadStats *stats;
+  int op;
+  uint64_t start;
+};
+} /* namespace details */
+
+} /* namespace lol */
+
+#if LOL_STATS
+/* Count and sample the rest of the enclosing block */
+#   define LOL_STATS_SCOPE(op)                                                 \
+      ::lol::details::StatsScope lol_stats_scope(::lol::Stats::op)
+/* Count only, for constexpr functions; not counted when evaluated at
+ * compile time */
+#   define LOL_STATS_COUNT(op)                                                 \
+      do {                                                                     \
+        if (!LOL_CONSTANT_EVALUATED())                                         \
+          ::lol::details::stats_count(::lol::details::local_stats(),           \
+                                      ::lol::Stats::op);                       \
+      } while (0)
+#else
+#   define LOL_STATS_SCOPE(op) do {} while (0)
+#   define LOL_STATS_COUNT(op) do {} while (0)
+#endif
+
+#endif // __LOL_STATS_H__
@@ -0,0 +1,323 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <string.h>
+
+#include <algorithm>
+#include <charconv>
+
+#include "lol/textio.h"
+
+using namespace std;
+
+namespace lol
+{
+
+/* Bytes of text per parallel block */
+static size_t const block_size = 1 << 20;
+
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Start of the line after the one holding p, or last */
+static inline char const *next_line(char const *p, char const *last)
+{
+    char const *nl = (char const *)memchr(p, '\n', last - p);
+    return nl ? nl + 1 : last;
+}
+
+/* Where the numbers of the line [p, eol) start, or nullptr if the line
+ * does not start with prefix and a blank */
+static inline char const *skip_prefix(char const *p, char const *eol,
+                                      char const *prefix, size_t len)
+{
+    while (p < eol && is_blank(*p))
+        p++;
+    if (!len)
+        return p;
+    if ((size_t)(eol - p) <= len || memcmp(p, prefix, len)
+         || !is_blank(p[len]))
+        return nullptr;
+    return p + len;
+}
+
+template <typename V, int N>
+static inline bool parse_line(char const *p, char const *eol, V &out)
+{
+    V ret;
+    for (int n = 0; n < N; n++)
+    {
+        while (p < eol && (is_blank(*p) || *p == ','))
+            p++;
+        /* from_chars() does not accept a plus sign */
+        if (p < eol && *p == '+')
+            p++;
+        from_chars_result r = from_chars(p, eol, ret[n]);
+        if (r.ec != errc())
+            return false;
+        p = r.ptr;
+    }
+    out = ret;
+    return true;
+}
+
+template <typename V, int N>
+static char const *parse(char const *first, char const *last,
+                         char const *prefix, V *out, int max, int &count,
+                         bool final)
+{
+    size_t len = strlen(prefix);
+    char const *p = first;
+
+    count = 0;
+    while (p < last)
+    {
+        char const *nl = (char const *)memchr(p, '\n', last - p);
+        if (!nl && !final)
+            break;
+
+        char const *eol = nl ? nl : last;
+        char const *q = skip_prefix(p, eol, prefix, len);
+        V tmp;
+        if (q && parse_line<V, N>(q, eol, tmp))
+        {
+            if (count == max)
+                break;
+            out[count++] = tmp;
+        }
+        p = nl ? nl + 1 : last;
+    }
+
+    return p;
+}
+
+/* The blocks are cut at line starts. Each one reserves room for all its
+ * lines that have the prefix, which is exact unless some fail to parse;
+ * the gaps those leave are closed afterwards. */
+template <typename V, int N>
+static char const *parse(ThreadPool &pool, char const *first,
+                         char const *last, char const *prefix,
+                         vector<V> &out, bool final)
+{
+    char const *end = last;
+    if (!final)
+        while (end > first && end[-1] != '\n')
+            end--;
+
+    int blocks = (int)((size_t)(end - first + block_size - 1) / block_size);
+    if (!blocks)
+        return end;
+
+    vector<char const *> starts(blocks + 1);
+    starts[0] = first;
+    starts[blocks] = end;
+    for (int b = 1; b < blocks; b++)
+        starts[b] = std::max(starts[b - 1],
+                             next_line(first + b * block_size - 1, end));
+
+    size_t len = strlen(prefix);
+    vector<int> counts(blocks), found(blocks);
+    pool.parallel_for(blocks, 1, [&](int b, int e)
+    {
+        for (; b < e; b++)
+        {
+            int n = 0;
+            for (char const *p = starts[b]; p < starts[b + 1]; )
+            {
+                char const *eol = next_line(p, starts[b + 1]);
+                n += skip_prefix(p, eol, prefix, len) != nullptr;
+                p = eol;
+            }
+            counts[b] = n;
+        }
+    });
+
+    size_t base = out.size(), total = 0;
+    vector<size_t> offsets(blocks);
+    for (int b = 0; b < blocks; b++)
+    {
+        offsets[b] = total;
+        total += counts[b];
+    }
+    out.resize(base + total);
+
+    V *dst = out.data() + base;
+    pool.parallel_for(blocks, 1, [&](int b, int e)
+    {
+        for (; b < e; b++)
+            parse<V, N>(starts[b], starts[b + 1], prefix, dst + offsets[b],
+                        counts[b], found[b], true);
+    });
+
+    size_t size = 0;
+    for (int b = 0; b < blocks; b++)
+    {
+        if (size != offsets[b])
+            memmove((void *)(dst + size), (void const *)(dst + offsets[b]),
+                    found[b] * sizeof(V));
+        size += found[b];
+    }
+    out.resize(base + size);
+
+    return end;
+}
+
+char const *parse_lines(char const *first, char const *last,
+                        char const *prefix, vec2 *out, int max, int &count,
+                        bool final)
+{
+    return parse<vec2, 2>(first, last, prefix, out, max, count, final);
+}
+
+char const *parse_lines(char const *first, char const *last,
+                        char const *prefix, vec3 *out, int max, int &count,
+                        bool final)
+{
+    return parse<vec3, 3>(first, last, prefix, out, max, count, final);
+}
+
+char const *parse_lines(char const *first, char const *last,
+                        char const *prefix, vec4 *out, int max, int &count,
+                        bool final)
+{
+    return parse<vec4, 4>(first, last, prefix, out, max, count, final);
+}
+
+char const *parse_lines(ThreadPool &pool, char const *first,
+                        char const *last, char const *prefix,
+                        vector<vec2> &out, bool final)
+{
+    return parse<vec2, 2>(pool, first, last, prefix, out, final);
+}
+
+char const *parse_lines(ThreadPool &pool, char const *first,
+                        char const *last, char const *prefix,
+                        vector<vec3> &out, bool final)
+{
+    return parse<vec3, 3>(pool, first, last, prefix, out, final);
+}
+
+char const *parse_lines(ThreadPool &pool, char const *first,
+                        char const *last, char const *prefix,
+                        vector<vec4> &out, bool final)
+{
+    return parse<vec4, 4>(pool, first, last, prefix, out, final);
+}
+
+/*
+ * Formatting
+ */
+
+static inline char *put(char *first, char *last, float const *x, int count)
+{
+    for (int n = 0; n < count; n++)
+    {
+        if (n)
+        {
+            if (first == last)
+                return nullptr;
+            *first++ = ' ';
+        }
+        to_chars_result r = to_chars(first, last, x[n]);
+        if (r.ec != errc())
+            return nullptr;
+        first = r.ptr;
+    }
+    return first;
+}
+
+char *format(char *first, char *last, vec2 const &v)
+{
+    float const x[] = { v.x, v.y };
+    return put(first, last, x, 2);
+}
+
+char *format(char *first, char *last, vec3 const &v)
+{
+    float const x[] = { v.x, v.y, v.z };
+    return put(first, last, x, 3);
+}
+
+char *format(char *first, char *last, vec4 const &v)
+{
+    float const x[] = { v.x, v.y, v.z, v.w };
+    return put(first, last, x, 4);
+}
+
+char *format(char *first, char *last, mat4 const &m)
+{
+    float x[16];
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            x[4 * i + j] = m[i][j];
+    return put(first, last, x, 16);
+}
+
+template <typename V>
+static int lines(char *first, char *last, char const *prefix, V const *in,
+                 int count, char *&end)
+{
+    size_t len = strlen(prefix);
+    int n = 0;
+
+    for (; n < count; n++)
+    {
+        char *p = first;
+        if (len)
+        {
+            if ((size_t)(last - p) < len + 1)
+                break;
+            memcpy(p, prefix, len);
+            p += len;
+            *p++ = ' ';
+        }
+        p = format(p, last, in[n]);
+        if (!p || p == last)
+            break;
+        *p++ = '\n';
+        first = p;
+    }
+
+    end = first;
+    return n;
+}
+
+int format_lines(char *first, char *last, char const *prefix,
+                 vec2 const *in, int count, char *&end)
+{
+    return lines(first, last, prefix, in, count, end);
+}
+
+int format_lines(char *first, char *last, char const *prefix,
+                 vec3 const *in, int count, char *&end)
+{
+    return lines(first, last, prefix, in, count, end);
+}
+
+int format_lines(char *first, char *last, char const *prefix,
+                 vec4 const *in, int count, char *&end)
+{
+    return lines(first, last, prefix, in, count, end);
+}
+
+int format_lines(char *first, char *last, char const *prefix,
+                 mat4 const *in, int count, char *&end)
+{
+    return lines(first, last, prefix, in, count, end);
+}
+
+} /* namespace lol */
+
@@ -0,0 +1,95 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// Text input and output
+// ---------------------
+// Vectors are read from and written to text one per line, as in OBJ
+// files ("v 1 2 3", "vn 0 0 1") or CSV point clouds ("1,2,3"). Numbers go
+// through std::from_chars and std::to_chars, so nothing is allocated per
+// element, the locale is ignored, and written floats read back exactly.
+//
+// parse_lines() is meant to be fed a file block by block. It consumes
+// complete lines only and returns where it stopped, so the caller keeps
+// the tail of a block and prepends it to the next:
+//
+//     char const *rest = lol::parse_lines(buf, buf + size, "v", out, max,
+//                                         count);
+//
+
+#if !defined __LOL_TEXTIO_H__
+#define __LOL_TEXTIO_H__
+
+#include <vector>
+
+#include "lol/matrix.h"
+#include "lol/threadpool.h"
+
+namespace lol {
+
+/*
+ * Parsing. A line is read when it starts with prefix followed by a blank,
+ * or with anything if prefix is empty. Leading blanks are skipped, and
+ * numbers may be separated by blanks or commas. Components past those of
+ * the vector are ignored, as is any line with too few numbers; other
+ * lines, such as comments and headers, are skipped.
+ *
+ * Up to max vectors are stored in out, and count is set to their number.
+ * Returns the start of the first line not consumed: the one that did not
+ * fit in out, or an unterminated last line unless final is true.
+ */
+char const *parse_lines(char const *first, char const *last,
+                        char const *prefix, vec2 *out, int max, int &count,
+                        bool final = false);
+char const *parse_lines(char const *first, char const *last,
+                        char const *prefix, vec3 *out, int max, int &count,
+                        bool final = false);
+char const *parse_lines(char const *first, char const *last,
+                        char const *prefix, vec4 *out, int max, int &count,
+                        bool final = false);
+
+/* Same, appending to out. Blocks of about 1 MB are parsed in parallel
+ * and written in place after a first pass that counts their lines. */
+char const *parse_lines(ThreadPool &pool, char const *first,
+                        char const *last, char const *prefix,
+                        std::vector<vec2> &out, bool final = false);
+char const *parse_lines(ThreadPool &pool, char const *first,
+                        char const *last, char const *prefix,
+                        std::vector<vec3> &out, bool final = false);
+char const *parse_lines(ThreadPool &pool, char const *first,
+                        char const *last, char const *prefix,
+                        std::vector<vec4> &out, bool final = false);
+
+/*
+ * Formatting. format() writes the components separated by spaces, in the
+ * shortest form that reads back exactly; a mat4 is written column after
+ * column. Like std::to_chars it returns the end of the text, or nullptr
+ * if [first, last) is too small. No terminating NUL is written.
+ */
+char *format(char *first, char *last, vec2 const &v);
+char *format(char *first, char *last, vec3 const &v);
+char *format(char *first, char *last, vec4 const &v);
+char *format(char *first, char *last, mat4 const &m);
+
+/* One line per element: prefix, a space if prefix is not empty, then the
+ * components. Stops before the first element that does not fit and
+ * returns how many were written; end is set past the last byte. */
+int format_lines(char *first, char *last, char const *prefix,
+                 vec2 const *in, int count, char *&end);
+int format_lines(char *first, char *last, char const *prefix,
+                 vec3 const *in, int count, char *&end);
+int format_lines(char *first, char *last, char const *prefix,
+                 vec4 const *in, int count, char *&end);
+int format_lines(char *first, char *last, char const *prefix,
+                 mat4 const *in, int count, char *&end);
+
+} /* namespace lol */
+
+#endif // __LOL_TEXTIO_H__
@@ -0,0 +1,218 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#if defined __linux__
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+#include "lol/threadpool.h"
+
+using namespace std;
+
+namespace lol
+{
+
+/* Set while a thread runs chunks, so that nested jobs run inline */
+static thread_local bool in_job = false;
+
+namespace
+{
+struct JobScope
+{
+    JobScope() { in_job = true; }
+    ~JobScope() { in_job = false; }
+};
+} /* namespace */
+
+ThreadPool::ThreadPool(int threads)
+  : generation(0),
+    busy(0),
+    quit(false),
+    job(nullptr),
+    ctx(nullptr),
+    job_count(0),
+    job_chunk(0)
+{
+    if (threads <= 0)
+        threads = max(1, (int)thread::hardware_concurrency());
+
+    /* Slot 0 belongs to whichever thread calls parallel_for() */
+    for (int n = 0; n < threads; n++)
+        slots.push_back(make_unique<Slot>());
+
+    /* The destructor does not run if a thread fails to start, so stop
+     * those already started here */
+    try
+    {
+        for (int n = 1; n < threads; n++)
+            slots[n]->thread = thread(&ThreadPool::worker, this, n);
+    }
+    catch (...)
+    {
+        stop();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::stop()
+{
+    {
+        unique_lock<mutex> l(lock);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for (size_t n = 0; n < slots.size(); n++)
+        if (slots[n]->thread.joinable())
+            slots[n]->thread.join();
+}
+
+bool ThreadPool::set_affinity(int n, int cpu)
+{
+#if defined __linux__
+    if (n < 1 || n >= count())
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !pthread_setaffinity_np(slots[n]->thread.native_handle(),
+                                   sizeof(set), &set);
+#else
+    (void)n;
+    (void)cpu;
+    return false;
+#endif
+}
+
+ThreadPool &ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::run(int items, int chunk, Job func, void const *data)
+{
+    if (in_job)
+    {
+        func(data, 0, items);
+        return;
+    }
+
+    unique_lock<mutex> s(submit);
+
+    /* Equal runs of consecutive chunks per slot */
+    int chunks = (items + chunk - 1) / chunk;
+    int threads = count();
+    for (int n = 0; n < threads; n++)
+    {
+        unique_lock<mutex> l(slots[n]->lock);
+        slots[n]->first = (int)((long long)chunks * n / threads);
+        slots[n]->last = (int)((long long)chunks * (n + 1) / threads);
+    }
+
+    {
+        unique_lock<mutex> l(lock);
+        job = func;
+        ctx = data;
+        job_count = items;
+        job_chunk = chunk;
+        busy = threads - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    /* Workers may still be running stolen chunks, and ctx must outlive
+     * them even if a chunk threw */
+    unique_lock<mutex> l(lock);
+    done.wait(l, [&] { return busy == 0; });
+    if (error)
+    {
+        exception_ptr e = error;
+        error = nullptr;
+        rethrow_exception(e);
+    }
+}
+
+void ThreadPool::worker(int n)
+{
+    int seen = 0;
+    for (;;)
+    {
+        {
+            unique_lock<mutex> l(lock);
+            wake.wait(l, [&] { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+        }
+
+        work(n);
+
+        unique_lock<mutex> l(lock);
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+void ThreadPool::work(int n)
+{
+    JobScope scope;
+    try
+    {
+        for (int c; take(n, c); )
+            job(ctx, c * job_chunk, min(job_count, (c + 1) * job_chunk));
+    }
+    catch (...)
+    {
+        /* Drop the chunks nobody has started */
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            unique_lock<mutex> l(slots[i]->lock);
+            slots[i]->first = slots[i]->last;
+        }
+
+        unique_lock<mutex> l(lock);
+        if (!error)
+            error = current_exception();
+    }
+}
+
+/* The front of our own run, or else the back of the next nonempty one */
+bool ThreadPool::take(int n, int &chunk)
+{
+    int threads = count();
+    for (int i = 0; i < threads; i++)
+    {
+        Slot *slot = slots[(n + i) % threads].get();
+        unique_lock<mutex> l(slot->lock);
+        if (slot->first < slot->last)
+        {
+            chunk = i ? --slot->last : slot->first++;
+            return true;
+        }
+    }
+    return false;
+}
+
+} /* namespace lol */
+
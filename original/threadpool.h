@@ -0,0 +1,104 @@
+//
+// Lol Engine
+//
+// Copyright: (c) 2010-2011 Sam Hocevar <sam@hocevar.net>
+//   This program is free software; you can redistribute it and/or
+//   modify it under the terms of the Do What The Fuck You Want To
+//   Public License, Version 2, as published by Sam Hocevar. See
+//   http://sam.zoy.org/projects/COPYING.WTFPL for more details.
+//
+
+//
+// The ThreadPool class
+// --------------------
+// A fixed set of worker threads that run parallel_for() jobs. The range
+// is cut into chunks and each thread, the caller included, starts with
+// an equal run of consecutive chunks. A thread takes chunks from the
+// front of its own run and, once it is empty, steals single chunks from
+// the back of the others', so uneven chunks still keep every thread busy.
+//
+// One job runs at a time; parallel_for() calls from inside a job run on
+// the calling thread. If func throws, the chunks not started yet are
+// dropped and the first exception is rethrown by parallel_for() once
+// every thread has stopped.
+//
+
+#if !defined __LOL_THREADPOOL_H__
+#define __LOL_THREADPOOL_H__
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lol {
+
+class ThreadPool {
+public:
+  /* Use threads threads including the caller, or one per hardware
+   * thread if threads is 0 */
+  explicit ThreadPool(int threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  inline int count() const { return (int)slots.size(); }
+
+  /* Pin worker thread n, in [1, count()), to the given CPU. Returns false
+   * where thread affinity is not supported. */
+  bool set_affinity(int n, int cpu);
+
+  /* Call func(begin, end) on consecutive ranges of at most chunk items
+   * covering [0, count), and return once they are all done */
+  template <typename F> void parallel_for(int count, int chunk, F const &func) {
+    if (count <= chunk || slots.size() < 2) {
+      if (count > 0)
+        func(0, count);
+      return;
+    }
+    run(count, chunk, &call<F>, &func);
+  }
+
+  /* Shared pool with one thread per hardware thread */
+  static ThreadPool &global();
+
+private:
+  typedef void (*Job)(void const *ctx, int begin, int end);
+
+  template <typename F>
+  static void call(void const *ctx, int begin, int end) {
+    (*(F const *)ctx)(begin, end);
+  }
+
+  struct Slot {
+    std::thread thread;
+    std::mutex lock;
+    int first = 0, last = 0; /* chunks not taken yet */
+  };
+
+  void stop();
+  void run(int items, int chunk, Job func, void const *data);
+  void worker(int n);
+  void work(int n);
+  bool take(int n, int &chunk);
+
+  std::vector<std::unique_ptr<Slot>> slots;
+
+  std::mutex submit, lock;
+  std::condition_variable wake, done;
+  int generation, busy;
+  bool quit;
+
+  /* Current job */
+  Job job;
+  void const *ctx;
+  int job_count, job_chunk;
+  std::exception_ptr error;
+};
+
+} /* namespace lol */
+
+#endif // __LOL_THREADPOOL_H__